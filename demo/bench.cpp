@@ -1,8 +1,16 @@
+#include <sys/socket.h>
+#include <sys/eventfd.h>
+#include <pthread.h>
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <string_view>
 #include <thread>
+#include <vector>
 #include <fmt/format.h> // https://github.com/fmtlib/fmt
 
 #include <liburing/io_service.hpp>
+#include <liburing/channel.hpp>
 
 struct stopwatch {
     stopwatch(std::string_view str_): str(str_) {}
@@ -15,12 +23,262 @@ struct stopwatch {
     clock::time_point start = clock::now();
 };
 
-int main() {
+// Round trips over socketpairs: every recv waits in the kernel, so its completion
+// goes through task work, which is what the setup flags change
+void bench_setup(std::string_view name, const uio::setup_options& options) {
     using uio::io_service;
     using uio::task;
+    using uio::panic_on_err;
+    using clock = std::chrono::steady_clock;
+
+    enum { PAIRS = 16, ROUNDS = 20000 };
+
+    io_service service(PAIRS * 4, options);
+    std::vector<uint32_t> latencies;
+    latencies.reserve(PAIRS * ROUNDS);
+
+    auto echo = [](io_service& service, int fd) -> task<> {
+        char c;
+        for (int i = 0; i < ROUNDS; ++i) {
+            co_await service.recv(fd, &c, 1, 0) | panic_on_err("recv", false);
+            co_await service.send(fd, &c, 1, 0) | panic_on_err("send", false);
+        }
+    };
+    auto ping = [](io_service& service, int fd, std::vector<uint32_t>& latencies) -> task<> {
+        char c = 'x';
+        for (int i = 0; i < ROUNDS; ++i) {
+            auto start = clock::now();
+            co_await service.send(fd, &c, 1, 0) | panic_on_err("send", false);
+            co_await service.recv(fd, &c, 1, 0) | panic_on_err("recv", false);
+            latencies.push_back(uint32_t((clock::now() - start) / std::chrono::nanoseconds(1)));
+        }
+    };
+
+    service.run([&] () -> task<> {
+        int fds[PAIRS][2];
+        std::vector<task<>> tasks;
+        for (auto& sv : fds) socketpair(AF_UNIX, SOCK_STREAM, 0, sv) | panic_on_err("socketpair", true);
+
+        auto start = clock::now();
+        for (auto& sv : fds) {
+            tasks.push_back(echo(service, sv[0]));
+            tasks.push_back(ping(service, sv[1], latencies));
+        }
+        for (auto& t : tasks) co_await t;
+        std::chrono::duration<double> elapsed = clock::now() - start;
+
+        for (auto& sv : fds) {
+            close(sv[0]);
+            close(sv[1]);
+        }
+        std::sort(latencies.begin(), latencies.end());
+        fmt::print("{:<16}{:#06x}{:>12.0f} round trips/s  p99 {:>6.1f}us  syscalls {}\n",
+            name,
+            service.setup_flags(),
+            latencies.size() / elapsed.count(),
+            latencies[latencies.size() * 99 / 100] / 1000.,
+            service.syscall_count());
+    }());
+}
+
+// The eventfd based mutex of threading.cpp: every lock and unlock is a syscall
+struct eventfd_mutex {
+    eventfd_mutex(): efd(::eventfd(1, EFD_CLOEXEC)) {}
+    ~eventfd_mutex() { ::close(efd); }
+
+    uio::task<> lock(uio::io_service& service) {
+        eventfd_t value;
+        co_await service.read(efd, &value, sizeof(value), 0);
+    }
+
+    void unlock() {
+        eventfd_write(efd, 1);
+    }
+
+    int efd;
+};
+
+// Coroutines holding the lock across a suspension point, so that all the others queue up
+template <typename Mutex, typename Lock>
+void bench_mutex(std::string_view name, Lock lock) {
+    using uio::io_service;
+    using uio::task;
+
+    enum { COROUTINES = 1000, ROUNDS = 10 };
+
+    io_service service(COROUTINES);
+    service.run([] (io_service& service, std::string_view name, Lock lock) -> task<> {
+        Mutex mutex(service);
+        unsigned long counter = 0;
+        std::vector<task<>> tasks;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < COROUTINES; ++i) {
+            tasks.push_back([] (io_service& service, Mutex& mutex, Lock lock, unsigned long& counter) -> task<> {
+                for (int j = 0; j < ROUNDS; ++j) {
+                    co_await lock(service, mutex);
+                    co_await service.yield();
+                    ++counter;
+                    mutex.unlock();
+                }
+            }(service, mutex, lock, counter));
+        }
+        for (auto& t : tasks) co_await t;
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        fmt::print("{:<16}{:>12.0f} locks/s  io_uring_enter {}\n", name, counter / elapsed.count(), service.syscall_count());
+    }(service, name, lock));
+}
+
+// Functions posted from a foreign thread: throughput of a burst, then wake-up latency of an idle ring
+void bench_post() {
+    using uio::io_service;
+    using uio::task;
+    using clock = std::chrono::steady_clock;
+
+    enum { POSTS = 1000000, PINGS = 2000 };
+
+    io_service service;
+    uio::async_event done(service);
+    unsigned long received = 0;
+    std::vector<uint32_t> latencies;
+    latencies.reserve(PINGS);
+
+    std::thread producer([&] {
+        auto start = clock::now();
+        for (int i = 0; i < POSTS; ++i) {
+            service.post([&] {
+                if (++received == POSTS) done.set();
+            });
+        }
+        std::chrono::duration<double> elapsed = clock::now() - start;
+        fmt::print("{:<16}{:>12.0f} posts/s\n", "post:", double(POSTS) / elapsed.count());
+
+        // One at a time, so that every post finds the ring asleep
+        std::atomic<bool> acked;
+        for (int i = 0; i < PINGS; ++i) {
+            acked.store(false, std::memory_order_relaxed);
+            service.post([&, start = clock::now()] {
+                latencies.push_back(uint32_t((clock::now() - start) / std::chrono::nanoseconds(1)));
+                acked.store(true, std::memory_order_release);
+                acked.notify_one();
+            });
+            acked.wait(false, std::memory_order_acquire);
+        }
+        service.post([&] { done.set(); });
+    });
+
+    service.run([] (uio::async_event& done) -> task<> {
+        co_await done.wait();
+        done.reset();
+        co_await done.wait();
+    }(done));
+    producer.join();
+
+    std::sort(latencies.begin(), latencies.end());
+    fmt::print("{:<16}p50 {:>6.1f}us  p99 {:>6.1f}us  io_uring_enter {}\n", "wake-up:",
+        latencies[latencies.size() / 2] / 1000.,
+        latencies[latencies.size() * 99 / 100] / 1000.,
+        service.syscall_count());
+}
+
+// Pin the calling thread, wrapping around the CPUs available
+static void pin_thread(unsigned cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu % std::max(std::thread::hardware_concurrency(), 1u), &set);
+    pthread_setaffinity_np(pthread_self(), sizeof set, &set);
+}
+
+// Channels between two pinned threads: throughput of a stream, then latency of a ping-pong
+void bench_channel() {
+    using uio::io_service;
+    using uio::task;
+    using clock = std::chrono::steady_clock;
+
+    enum { VALUES = 1000000, PINGS = 20000 };
+
+    uio::channel<int> stream(1024), ping(1), pong(1);
+    uint64_t peer_syscalls = 0;
+
+    std::thread peer([&] {
+        pin_thread(1);
+        io_service service;
+        service.run([] (io_service& service, uio::channel<int>& stream, uio::channel<int>& ping, uio::channel<int>& pong) -> task<> {
+            for (int i = 0; i < VALUES; ++i) co_await stream.send(service, i);
+            for (int i = 0; i < PINGS; ++i) co_await pong.send(service, co_await ping.recv(service));
+        }(service, stream, ping, pong));
+        peer_syscalls = service.syscall_count();
+    });
+
+    pin_thread(0);
+    io_service service;
+    std::vector<uint32_t> latencies;
+    latencies.reserve(PINGS);
+    service.run([] (io_service& service, uio::channel<int>& stream, uio::channel<int>& ping, uio::channel<int>& pong, std::vector<uint32_t>& latencies) -> task<> {
+        auto start = clock::now();
+        long sum = 0;
+        for (int i = 0; i < VALUES; ++i) sum += co_await stream.recv(service);
+        std::chrono::duration<double> elapsed = clock::now() - start;
+        fmt::print("{:<16}{:>12.0f} values/s  io_uring_enter {}\n", "stream:", double(VALUES) / elapsed.count(), service.syscall_count());
+        if (sum != long(VALUES) * (VALUES - 1) / 2) uio::panic("bench_channel", EINVAL);
+
+        for (int i = 0; i < PINGS; ++i) {
+            start = clock::now();
+            co_await ping.send(service, i);
+            co_await pong.recv(service);
+            latencies.push_back(uint32_t((clock::now() - start) / std::chrono::nanoseconds(1)));
+        }
+    }(service, stream, ping, pong, latencies));
+    peer.join();
+
+    std::sort(latencies.begin(), latencies.end());
+    fmt::print("{:<16}p50 {:>6.1f}us  p99 {:>6.1f}us  io_uring_enter {} + {}\n", "round trip:",
+        latencies[latencies.size() / 2] / 1000.,
+        latencies[latencies.size() * 99 / 100] / 1000.,
+        service.syscall_count(), peer_syscalls);
+}
+
+int main(int argc, char* argv[]) {
+    using uio::io_service;
+    using uio::task;
+
+    if (argc > 1 && argv[1] == std::string_view("setup")) {
+        fmt::print("{:<16}{}\n", "", "flags");
+        bench_setup("none:", { .single_issuer = false, .defer_taskrun = false, .coop_taskrun = false });
+        bench_setup("coop:", { .single_issuer = false, .defer_taskrun = false, .coop_taskrun = true });
+        bench_setup("single_issuer:", { .single_issuer = true, .defer_taskrun = false, .coop_taskrun = false });
+        bench_setup("defer:", { .single_issuer = true, .defer_taskrun = true, .coop_taskrun = false });
+        bench_setup("all:", {});
+        return 0;
+    }
+
+    if (argc > 1 && argv[1] == std::string_view("post")) {
+        bench_post();
+        return 0;
+    }
+
+    if (argc > 1 && argv[1] == std::string_view("channel")) {
+        bench_channel();
+        return 0;
+    }
+
+    if (argc > 1 && argv[1] == std::string_view("mutex")) {
+        struct eventfd_mutex_of: eventfd_mutex {
+            explicit eventfd_mutex_of(io_service&) {}
+        };
+        bench_mutex<eventfd_mutex_of>("eventfd:", [] (io_service& service, eventfd_mutex_of& mutex) {
+            return mutex.lock(service);
+        });
+        bench_mutex<uio::async_mutex>("async_mutex:", [] (io_service&, uio::async_mutex& mutex) {
+            return mutex.lock();
+        });
+        return 0;
+    }
 
     io_service service;
     const auto iteration = 10000000;
+    // Operations in flight per submission for the batched cases, so that the
+    // cost of completion dispatch isn't buried under the syscall
+    const auto batch = 64;
 
     service.run([] (io_service& service) -> task<> {
         {
@@ -30,32 +288,70 @@ int main() {
             }
         }
         {
-            stopwatch sw("plain IORING_OP_NOP:");
-            for (int i = 0; i < iteration; ++i) {
-                auto* ring = &service.get_handle();
-                auto* sqe = io_uring_get_sqe(ring);
-                io_uring_prep_nop(sqe);
-                io_uring_submit_and_wait(ring, 1);
-
-                io_uring_cqe *cqe;
-                io_uring_peek_cqe(ring, &cqe);
-                (void) cqe->res;
-                io_uring_cqe_seen(ring, cqe);
+            stopwatch sw("service.yield x64:");
+            std::vector<task<>> workers;
+            for (int i = 0; i < batch; ++i) {
+                workers.push_back([] (io_service& service) -> task<> {
+                    for (int i = 0; i < iteration / batch; ++i) {
+                        co_await service.yield();
+                    }
+                }(service));
             }
+            for (auto& worker : workers) co_await worker;
         }
         {
-            stopwatch sw("this_thread::yield:");
+            stopwatch sw("empty task:");
             for (int i = 0; i < iteration; ++i) {
-                std::this_thread::yield();
+                co_await [] () -> task<> { co_return; }();
             }
         }
-#if defined(__i386__) || defined(__x86_64__)
-        {
-            stopwatch sw("pause:");
-            for (int i = 0; i < iteration; ++i) {
-                __builtin_ia32_pause();
+    }(service));
+
+    {
+        // Drive the ring by hand outside of service.run, which would reap these cqes too
+        stopwatch sw("plain IORING_OP_NOP:");
+        auto* ring = &service.get_handle();
+        for (int i = 0; i < iteration; ++i) {
+            auto* sqe = io_uring_get_sqe(ring);
+            io_uring_prep_nop(sqe);
+            io_uring_submit_and_wait(ring, 1);
+
+            io_uring_cqe *cqe;
+            io_uring_peek_cqe(ring, &cqe);
+            (void) cqe->res;
+            io_uring_cqe_seen(ring, cqe);
+        }
+    }
+    {
+        stopwatch sw("plain IORING_OP_NOP x64:");
+        auto* ring = &service.get_handle();
+        for (int i = 0; i < iteration / batch; ++i) {
+            for (int j = 0; j < batch; ++j) {
+                io_uring_prep_nop(io_uring_get_sqe(ring));
             }
+            io_uring_submit_and_wait(ring, batch);
+
+            io_uring_cqe *cqe;
+            unsigned head, count = 0;
+            io_uring_for_each_cqe(ring, head, cqe) {
+                (void) cqe->res;
+                ++count;
+            }
+            io_uring_cq_advance(ring, count);
+        }
+    }
+    {
+        stopwatch sw("this_thread::yield:");
+        for (int i = 0; i < iteration; ++i) {
+            std::this_thread::yield();
         }
+    }
+#if defined(__i386__) || defined(__x86_64__)
+    {
+        stopwatch sw("pause:");
+        for (int i = 0; i < iteration; ++i) {
+            __builtin_ia32_pause();
+        }
+    }
 #endif
-    }(service));
 }
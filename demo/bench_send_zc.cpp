@@ -0,0 +1,91 @@
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <chrono>
+#include <vector>
+#include <fmt/format.h> // https://github.com/fmtlib/fmt
+
+#include <liburing/io_service.hpp>
+
+// Compare IORING_OP_SEND and IORING_OP_SEND_ZC over a loopback TCP connection
+// NOTE: loopback delivery copies zero-copy pages anyway, so it shows the overhead
+// of the notification rather than the saving you get on a real NIC
+
+enum {
+    TOTAL_SIZE = 1 << 30,
+};
+
+uio::task<> drain(uio::io_service& service, int fd, size_t total) {
+    std::vector<char> buf(1 << 20);
+    while (total > 0) {
+        int r = co_await service.recv(fd, buf.data(), buf.size(), 0) | uio::panic_on_err("recv", false);
+        if (r == 0) uio::panic("recv", ECONNRESET);
+        total -= size_t(r);
+    }
+}
+
+uio::task<> bench(uio::io_service& service, int sender, int receiver, unsigned payload, bool zc) {
+    using uio::panic_on_err;
+
+    std::vector<char> buf(payload, 'x');
+    const size_t total = TOTAL_SIZE / payload * payload;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    auto drained = drain(service, receiver, total);
+    for (size_t sent = 0; sent < total; ) {
+        int r;
+        if (zc) {
+            auto op = service.send_zc(sender, buf.data(), payload, MSG_NOSIGNAL);
+            r = co_await op | panic_on_err("send_zc", false);
+            // The buffer is reused for the next send
+            co_await op.notified();
+        } else {
+            r = co_await service.send(sender, buf.data(), payload, MSG_NOSIGNAL) | panic_on_err("send", false);
+        }
+        sent += size_t(r);
+    }
+    co_await drained;
+    std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+
+    fmt::print("{:<12}{:>10}{:>12.2f} MiB/s\n",
+        zc ? "send_zc:" : "send:",
+        payload,
+        double(total) / (1 << 20) / elapsed.count());
+}
+
+int main() {
+    using uio::io_service;
+    using uio::panic_on_err;
+    using uio::panic;
+    using uio::task;
+
+    int listener = socket(AF_INET, SOCK_STREAM, 0) | panic_on_err("socket", true);
+    sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = 0,
+        .sin_addr = { htonl(INADDR_LOOPBACK) },
+        .sin_zero = {},
+    };
+    socklen_t addrlen = sizeof (addr);
+    if (bind(listener, reinterpret_cast<sockaddr *>(&addr), addrlen)) panic("bind", errno);
+    if (listen(listener, 1)) panic("listen", errno);
+    if (getsockname(listener, reinterpret_cast<sockaddr *>(&addr), &addrlen)) panic("getsockname", errno);
+
+    int sender = socket(AF_INET, SOCK_STREAM, 0) | panic_on_err("socket", true);
+    if (connect(sender, reinterpret_cast<sockaddr *>(&addr), addrlen)) panic("connect", errno);
+    int receiver = accept(listener, nullptr, nullptr) | panic_on_err("accept", true);
+    close(listener);
+
+    io_service service;
+
+    service.run([&] () -> task<> {
+        for (unsigned payload : { 4u << 10, 64u << 10, 1u << 20 }) {
+            co_await bench(service, sender, receiver, payload, false);
+            co_await bench(service, sender, receiver, payload, true);
+        }
+    }());
+
+    close(sender);
+    close(receiver);
+}
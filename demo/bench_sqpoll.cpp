@@ -0,0 +1,61 @@
+#include <chrono>
+#include <vector>
+#include <fmt/format.h> // https://github.com/fmtlib/fmt
+
+#include <liburing/io_service.hpp>
+
+// Variant of bench.cpp: IORING_OP_NOP round trips with and without SQPOLL,
+// reporting syscalls per op next to ops/sec
+// NOTE: the poller thread needs a CPU of its own. On a single core it competes
+// with the application thread, and spinning on the CQ only burns its time slice
+
+enum {
+    WORKERS = 16,
+    ITERATIONS = 200000,
+};
+
+void bench(std::string_view name, uio::io_service& service) {
+    using uio::task;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    service.run([] (uio::io_service& service) -> task<> {
+        std::vector<task<>> workers;
+        for (int i = 0; i < WORKERS; ++i) {
+            workers.push_back([] (uio::io_service& service) -> task<> {
+                for (int i = 0; i < ITERATIONS; ++i) {
+                    co_await service.yield();
+                }
+            }(service));
+        }
+        for (auto& worker : workers) co_await worker;
+    }(service));
+    std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+
+    const double ops = double(WORKERS) * double(ITERATIONS);
+    fmt::print("{:<20}{:>14.0f} ops/s{:>10.4f} syscalls/op\n",
+        name,
+        ops / elapsed.count(),
+        double(service.syscall_count()) / ops);
+}
+
+int main() {
+    using uio::io_service;
+    using uio::sqpoll_options;
+
+    {
+        io_service service(WORKERS * 2);
+        bench("default:", service);
+    }
+    {
+        io_service service(WORKERS * 2, sqpoll_options { .idle_ms = 1000 });
+        bench("sqpoll:", service);
+    }
+    {
+        io_service service(WORKERS * 2, sqpoll_options { .idle_ms = 1000, .spin_us = 100 });
+        bench("sqpoll + spin:", service);
+    }
+    {
+        io_service service(WORKERS * 2, sqpoll_options { .idle_ms = 1000, .cpu = 0, .spin_us = 100 });
+        bench("sqpoll + spin, cpu0:", service);
+    }
+}
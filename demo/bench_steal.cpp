@@ -0,0 +1,80 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <fmt/format.h> // https://github.com/fmtlib/fmt
+
+#include <liburing/runtime.hpp>
+
+// Skewed load on a runtime: most requests arrive on worker 0. Each one is a
+// CPU-bound job split into chunks. Static partitioning yields to its own ring
+// between chunks, work stealing lets idle workers pick the chunks up
+// Reports the latency of requests, measured from the moment all of them are started
+// NOTE: it takes more than one CPU for stealing to pay off
+
+enum {
+    THREADS = 4,
+    REQUESTS = 2000,
+    // Percentage of requests arriving on worker 0
+    SKEW = 90,
+    CHUNKS = 10,
+    CHUNK_US = 20,
+};
+
+using clock_type = std::chrono::steady_clock;
+
+void spin(std::chrono::microseconds duration) {
+    auto until = clock_type::now() + duration;
+    while (clock_type::now() < until) {}
+}
+
+void bench(std::string_view name, bool steal) {
+    using uio::io_service;
+    using uio::runtime;
+    using uio::stealable;
+
+    runtime rt(THREADS);
+    std::vector<double> latencies(REQUESTS);
+    std::atomic<int> remaining = REQUESTS;
+    const auto start = clock_type::now();
+
+    // Only a stealable coroutine may move to another worker
+    auto request = [&](io_service& service, int id) -> stealable {
+        for (int i = 0; i < CHUNKS; ++i) {
+            spin(std::chrono::microseconds(CHUNK_US));
+            if (steal) {
+                co_await rt.schedule();
+            } else {
+                co_await service.yield();
+            }
+        }
+        latencies[id] = std::chrono::duration<double, std::milli>(clock_type::now() - start).count();
+        if (--remaining == 0) rt.stop();
+    };
+
+    // Workers other than 0 share the rest evenly
+    const int hot = REQUESTS * SKEW / 100;
+    auto core_of = [&](int id) {
+        return id < hot ? 0u : 1 + unsigned(id - hot) % (rt.size() - 1);
+    };
+    for (unsigned core = 0; core < rt.size(); ++core) {
+        rt.post(core, [&, core] {
+            for (int id = 0; id < REQUESTS; ++id) {
+                if (core_of(id) == core) request(rt.service(core), id);
+            }
+        });
+    }
+    rt.run_until_stopped();
+
+    std::sort(latencies.begin(), latencies.end());
+    fmt::print("{:<10}p50 {:>8.2f}ms  p99 {:>8.2f}ms  max {:>8.2f}ms\n",
+        name,
+        latencies[REQUESTS / 2],
+        latencies[REQUESTS * 99 / 100],
+        latencies.back());
+}
+
+int main() {
+    bench("static:", false);
+    bench("steal:", true);
+}
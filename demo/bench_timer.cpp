@@ -0,0 +1,66 @@
+#include <chrono>
+#include <deque>
+#include <random>
+#include <fmt/format.h> // https://github.com/fmtlib/fmt
+
+#include <liburing/io_service.hpp>
+
+// Arms and cancels 1M idle timeouts on the timer wheel, then lets 1M short timers
+// fire. For reference, 100K kernel timeouts ( one sqe + cqe + hrtimer each ) fire too
+
+enum {
+    TIMERS = 1000000,
+    KERNEL_TIMEOUTS = 100000,
+};
+
+using clock_type = std::chrono::steady_clock;
+
+double elapsed_ns(clock_type::time_point start, int n) {
+    return std::chrono::duration<double, std::nano>(clock_type::now() - start).count() / n;
+}
+
+int main() {
+    using uio::io_service;
+    using uio::task;
+    using namespace std::literals;
+
+    io_service service(4096);
+    std::mt19937 rng(42);
+    int fired = 0;
+
+    std::deque<uio::timer> timers;
+    for (int i = 0; i < TIMERS; ++i) timers.emplace_back(service, [&] { ++fired; });
+
+    // Idle timeouts of connections: armed far away, canceled before they expire
+    auto start = clock_type::now();
+    for (auto& t : timers) t.expires_after(std::chrono::milliseconds(1000 + rng() % 60000));
+    fmt::print("wheel arm:        {:>8.1f} ns/timer\n", elapsed_ns(start, TIMERS));
+    start = clock_type::now();
+    for (auto& t : timers) t.expires_after(std::chrono::milliseconds(1000 + rng() % 60000));
+    fmt::print("wheel rearm:      {:>8.1f} ns/timer\n", elapsed_ns(start, TIMERS));
+    start = clock_type::now();
+    for (auto& t : timers) t.cancel();
+    fmt::print("wheel cancel:     {:>8.1f} ns/timer\n", elapsed_ns(start, TIMERS));
+
+    // All of them expire within 100ms, the cost of waiting is not counted
+    for (auto& t : timers) t.expires_after(std::chrono::milliseconds(rng() % 100));
+    start = clock_type::now();
+    service.run([&] () -> task<> {
+        while (fired < TIMERS) co_await service.sleep_for(10ms);
+    }());
+    auto total = std::chrono::duration<double, std::milli>(clock_type::now() - start).count();
+    fmt::print("wheel fire:       {} timers in {:.1f}ms\n", fired, total);
+
+    int kernel_fired = 0;
+    start = clock_type::now();
+    service.run([&] () -> task<> {
+        auto ts = uio::dur2ts(std::chrono::milliseconds(1000));
+        for (int i = 0; i < KERNEL_TIMEOUTS; ++i) {
+            service.timeout(&ts).set_callback([&](int) { ++kernel_fired; });
+        }
+        while (kernel_fired < KERNEL_TIMEOUTS) co_await service.sleep_for(10ms);
+    }());
+    total = std::chrono::duration<double, std::milli>(clock_type::now() - start).count();
+    fmt::print("kernel timeouts:  {} timeouts in {:.1f}ms ( {:.1f}ms past the deadline )\n",
+        kernel_fired, total, total - 1000);
+}
@@ -2,6 +2,7 @@
 #include <sys/socket.h>
 #include <sys/ioctl.h>
 #include <netinet/in.h>
+#include <cstring>
 #include <fmt/format.h> // https://github.com/fmtlib/fmt
 #include <vector>
 #include <numeric>
@@ -11,23 +12,42 @@
 #define USE_SPLICE 0
 #define USE_LINK 0
 #define USE_POLL 0
+#define USE_BUFFER_RING 0
+#define USE_ZC 0
 
 enum {
     BUF_SIZE = 512,
     MAX_CONN_SIZE = 512,
+    BUF_RING_SIZE = 256,
 };
 
 int runningCoroutines = 0;
 
 uio::task<> accept_connection(uio::io_service& service, int serverfd) {
-    while (int clientfd = co_await service.accept(serverfd, nullptr, nullptr)) {
-        [](uio::io_service& service, int clientfd) -> uio::task<> {
+#if USE_BUFFER_RING
+    // Buffers are shared by all connections and only picked when data arrives
+    uio::buffer_ring buffers(service, 0, BUF_RING_SIZE, BUF_SIZE);
+#endif
+    auto connections = service.multishot_accept(serverfd);
+    while (int clientfd = co_await connections.next()) {
+        if (clientfd < 0) {
+            fmt::print("accept failed: {}\n", std::strerror(-clientfd));
+            continue;
+        }
+        [](uio::io_service& service, int clientfd
+#if USE_BUFFER_RING
+            , uio::buffer_ring& buffers
+#endif
+        ) -> uio::task<> {
             fmt::print("sockfd {} is accepted; number of running coroutines: {}\n",
                 clientfd, ++runningCoroutines);
 #if USE_SPLICE
             int pipefds[2];
             pipe(pipefds) | panic_on_err("pipe", true);
             on_scope_exit([&] { close(pipefds[0]); close(pipefds[1]); });
+#elif USE_BUFFER_RING
+            // One multishot recv per connection instead of one sqe per message
+            auto messages = service.multishot_recv(clientfd, buffers, MSG_NOSIGNAL);
 #else
             std::vector<char> buf(BUF_SIZE);
 #endif
@@ -52,10 +72,25 @@ uio::task<> accept_connection(uio::io_service& service, int serverfd) {
 #else
 #   if USE_LINK
 #       error "This won't work because short read of IORING_OP_RECV is not considered an error"
+#   elif USE_BUFFER_RING
+                auto buf = co_await messages.next();
+                if (buf.result() <= 0) break;
+#       if USE_ZC
+                // The buffer goes back to the ring once the kernel is done with it
+                co_await service.send_zc(clientfd, std::move(buf), MSG_NOSIGNAL);
+#       else
+                co_await service.send(clientfd, buf.data(), buf.size(), MSG_NOSIGNAL);
+#       endif
 #   else
                 int r = co_await service.recv(clientfd, buf.data(), BUF_SIZE, MSG_NOSIGNAL);
                 if (r <= 0) break;
+#       if USE_ZC
+                auto op = service.send_zc(clientfd, buf.data(), r, MSG_NOSIGNAL);
+                co_await op;
+                co_await op.notified();
+#       else
                 co_await service.send(clientfd, buf.data(), r, MSG_NOSIGNAL);
+#       endif
 #   endif
 #endif
             }
@@ -63,7 +98,11 @@ uio::task<> accept_connection(uio::io_service& service, int serverfd) {
             co_await service.close(clientfd);
             fmt::print("sockfd {} is closed; number of running coroutines: {}\n",
                 clientfd, --runningCoroutines);
-        }(service, clientfd);
+        }(service, clientfd
+#if USE_BUFFER_RING
+            , buffers
+#endif
+        );
     }
 }
 
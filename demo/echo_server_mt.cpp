@@ -0,0 +1,123 @@
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <vector>
+#include <fmt/format.h> // https://github.com/fmtlib/fmt
+
+#include <liburing/acceptor.hpp>
+
+// Variant of echo_server.cpp: the main thread accepts connections and moves them
+// into the rings of worker threads ( IORING_MSG_SEND_FD ), picking the least loaded one.
+// With a connection count, it also connects to itself and reports connections/sec
+
+enum {
+    BUF_SIZE = 512,
+    MAX_CONN_SIZE = 512,
+    CLIENTS = 64,
+};
+
+std::unique_ptr<std::atomic<unsigned>[]> served;
+
+uio::task<> echo(uio::io_service& service, int fd, unsigned core) {
+    served[core].fetch_add(1, std::memory_order_relaxed);
+    std::vector<char> buf(BUF_SIZE);
+    while (true) {
+        int r = co_await service.recv(fd, buf.data(), BUF_SIZE, MSG_NOSIGNAL, IOSQE_FIXED_FILE);
+        if (r <= 0) break;
+        co_await service.send(fd, buf.data(), r, MSG_NOSIGNAL, IOSQE_FIXED_FILE);
+    }
+}
+
+// Each client opens a connection, round-trips one message and closes it, over and over
+uio::task<> client(uio::io_service& service, uint16_t port, int count) {
+    using uio::panic_on_err;
+
+    sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+        .sin_addr = { htonl(INADDR_LOOPBACK) },
+        .sin_zero = {},
+    };
+    for (int i = 0; i < count; ++i) {
+        int fd = socket(AF_INET, SOCK_STREAM, 0) | panic_on_err("socket creation", true);
+        co_await service.connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof (addr)) | panic_on_err("connect", false);
+        char c = 'x';
+        co_await service.send(fd, &c, 1, MSG_NOSIGNAL) | panic_on_err("send", false);
+        co_await service.recv(fd, &c, 1, MSG_NOSIGNAL) | panic_on_err("recv", false);
+        co_await service.close(fd);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    using uio::io_service;
+    using uio::panic_on_err;
+    using uio::on_scope_exit;
+    using uio::panic;
+    using uio::task;
+
+    uint16_t server_port = 0;
+    int connections = 0;
+    if (argc == 2 || argc == 3) {
+        server_port = (uint16_t)std::strtoul(argv[1], nullptr, 10);
+        if (argc == 3) connections = std::atoi(argv[2]);
+    }
+    if (server_port == 0) {
+        fmt::print("Usage: {} <PORT> [CONNECTIONS]\n", argv[0]);
+        return 1;
+    }
+
+    uio::runtime rt(0, MAX_CONN_SIZE, 0, MAX_CONN_SIZE);
+    served.reset(new std::atomic<unsigned>[rt.size()]());
+
+    io_service service(MAX_CONN_SIZE);
+    service.register_files_sparse(MAX_CONN_SIZE);
+    uio::acceptor acceptor(service, rt);
+
+    int sockfd = socket(AF_INET, SOCK_STREAM, 0) | panic_on_err("socket creation", true);
+    on_scope_exit closesock([=]() { shutdown(sockfd, SHUT_RDWR); });
+
+    if (int on = 1; setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof (on))) panic("SO_REUSEADDR", errno);
+    if (sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(server_port),
+        .sin_addr = { INADDR_ANY },
+        .sin_zero = {},
+    }; bind(sockfd, reinterpret_cast<sockaddr *>(&addr), sizeof (sockaddr_in))) panic("socket binding", errno);
+
+    if (listen(sockfd, MAX_CONN_SIZE * 2)) panic("listen", errno);
+    fmt::print("Listening: {} on {} worker threads\n", server_port, rt.size());
+
+    // Runs until the listening socket is shut down
+    auto server = acceptor.serve(sockfd, [&rt](io_service& service, int fd) {
+        return echo(service, fd, unsigned(rt.current_core()));
+    });
+    if (connections <= 0) {
+        service.run(server);
+        return 0;
+    }
+
+    service.run([](io_service& service, task<int>& server, int sockfd, uint16_t port, int connections) -> task<> {
+        auto start = std::chrono::high_resolution_clock::now();
+        std::vector<task<>> clients;
+        for (int i = 0; i < CLIENTS; ++i) {
+            clients.push_back(client(service, port, connections / CLIENTS + (i < connections % CLIENTS)));
+        }
+        for (auto& c : clients) co_await c;
+        std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+        fmt::print("{} connections in {:.3f}s: {:.0f} connections/s\n",
+            connections, elapsed.count(), connections / elapsed.count());
+
+        // Fail the pending accept to let the acceptor return
+        shutdown(sockfd, SHUT_RDWR);
+        co_await server;
+    }(service, server, sockfd, server_port, connections));
+
+    for (unsigned core = 0; core < rt.size(); ++core) {
+        fmt::print("worker {}: {} connections\n", core, served[core].load());
+    }
+}
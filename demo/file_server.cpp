@@ -8,10 +8,13 @@
 #include <string_view>
 #include <chrono>
 #include <cerrno>
+#include <cstring>
+#include <atomic>
+#include <vector>
 #include <fmt/format.h> // https://github.com/fmtlib/fmt
 #include <fmt/chrono.h>
 
-#include <liburing/io_service.hpp>
+#include <liburing/runtime.hpp>
 
 enum {
     SERVER_PORT = 8080,
@@ -20,12 +23,15 @@ enum {
 
 using namespace std::literals;
 
+// Clients that are too slow to send a request are dropped ( slowloris )
+constexpr auto request_timeout = 5s;
+
 // Predefined HTTP error response headers
 static constexpr const auto http_400_hdr = "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\n\r\n"sv;
 static constexpr const auto http_403_hdr = "HTTP/1.1 403 Forbidden\r\nContent-Length: 0\r\n\r\n"sv;
 static constexpr const auto http_404_hdr = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n"sv;
 
-int runningCoroutines = 0;
+std::atomic<int> runningCoroutines = 0;
 
 // Serve response
 uio::task<> http_send_file(uio::io_service& service, std::string filename, int clientfd, int dirfd) {
@@ -62,14 +68,18 @@ uio::task<> http_send_file(uio::io_service& service, std::string filename, int c
         off_t offset = 0;
         std::array<char, BUF_SIZE> filebuf;
         for (; st.st_size - offset > BUF_SIZE; offset += BUF_SIZE) {
-            auto t = service.read(infd, filebuf.data(), filebuf.size(), offset, IOSQE_IO_LINK) | panic_on_err("read" , false);
-            co_await service.send(clientfd, filebuf.data(), filebuf.size(), MSG_NOSIGNAL | MSG_MORE) | panic_on_err("send", false);
+            service.read(infd, filebuf.data(), filebuf.size(), offset, IOSQE_IO_LINK);
+            auto op = service.send_zc(clientfd, filebuf.data(), filebuf.size(), MSG_NOSIGNAL | MSG_MORE);
+            co_await op | panic_on_err("send_zc", false);
+            co_await op.notified(); // filebuf is reused by the next read
             auto ts = dur2ts(100ms);
             co_await service.timeout(&ts) | panic_on_err("timeout" , false); // For debugging
         }
         if (st.st_size > offset) {
-            auto t = service.read(infd, filebuf.data(), st.st_size - offset, offset, IOSQE_IO_LINK) | panic_on_err("read", false);
-            co_await service.send(clientfd, filebuf.data(), st.st_size - offset, MSG_NOSIGNAL) | panic_on_err("send", false);
+            service.read(infd, filebuf.data(), st.st_size - offset, offset, IOSQE_IO_LINK);
+            auto op = service.send_zc(clientfd, filebuf.data(), st.st_size - offset, MSG_NOSIGNAL);
+            co_await op | panic_on_err("send_zc", false);
+            co_await op.notified();
         }
     }
 }
@@ -83,7 +93,11 @@ uio::task<> serve(uio::io_service& service, int clientfd, int dirfd) {
 
     std::array<char, BUF_SIZE> buffer;
 
-    int res = co_await service.recv(clientfd, buffer.data(), buffer.size(), 0) | panic_on_err("recv", false);
+    int res = co_await service.recv(clientfd, buffer.data(), buffer.size(), 0).with_timeout(request_timeout) | panic_on_err("recv", false);
+    if (res == -ETIME) {
+        fmt::print("sockfd {} timed out waiting for a request\n", clientfd);
+        co_return;
+    }
 
     std::string_view buf_view = std::string_view(buffer.data(), size_t(res));
 
@@ -101,7 +115,12 @@ uio::task<> serve(uio::io_service& service, int clientfd, int dirfd) {
 uio::task<> accept_connection(uio::io_service& service, int serverfd, int dirfd) {
     using uio::task;
 
-    while (int clientfd = co_await service.accept(serverfd, nullptr, nullptr)) {
+    auto connections = service.multishot_accept(serverfd);
+    while (int clientfd = co_await connections.next()) {
+        if (clientfd < 0) {
+            fmt::print("accept failed: {}\n", std::strerror(-clientfd));
+            continue;
+        }
         // Start worker coroutine to handle new requests
         [](uio::io_service& service, int dirfd, int clientfd) -> task<> {
             ++runningCoroutines;
@@ -139,24 +158,34 @@ int main(int argc, char* argv[]) {
     int dirfd = open(argv[1], O_DIRECTORY) | panic_on_err("open dir", true);
     on_scope_exit closedir([=]() { close(dirfd); });
 
-    int sockfd = socket(AF_INET, SOCK_STREAM, 0) | panic_on_err("socket creation", true);
-    on_scope_exit closesock([=]() { close(sockfd); });
+    uio::runtime rt;
 
-    if (int on = 1; setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof (on))) panic("SO_REUSEADDR", errno);
-    if (int on = 1; setsockopt(sockfd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof (on))) panic("SO_REUSEPORT", errno);
+    // One listening socket per worker, the kernel spreads connections over them ( SO_REUSEPORT )
+    std::vector<int> sockfds;
+    on_scope_exit closesocks([&]() { for (int sockfd : sockfds) close(sockfd); });
+    for (unsigned core = 0; core < rt.size(); ++core) {
+        int sockfd = socket(AF_INET, SOCK_STREAM, 0) | panic_on_err("socket creation", true);
+        sockfds.push_back(sockfd);
 
-    if (sockaddr_in addr = {
-        .sin_family = AF_INET,
-        .sin_port = htons(SERVER_PORT),
-        .sin_addr = { INADDR_ANY },
-        .sin_zero = {}, // Silense compiler warnings
-    }; bind(sockfd, reinterpret_cast<sockaddr *>(&addr), sizeof (sockaddr_in))) panic("socket binding", errno);
+        if (int on = 1; setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof (on))) panic("SO_REUSEADDR", errno);
+        if (int on = 1; setsockopt(sockfd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof (on))) panic("SO_REUSEPORT", errno);
 
-    if (listen(sockfd, 128)) panic("listen", errno);
-    fmt::print("Listening: {}\n", (uint16_t) SERVER_PORT);
+        if (sockaddr_in addr = {
+            .sin_family = AF_INET,
+            .sin_port = htons(SERVER_PORT),
+            .sin_addr = { INADDR_ANY },
+            .sin_zero = {}, // Silense compiler warnings
+        }; bind(sockfd, reinterpret_cast<sockaddr *>(&addr), sizeof (sockaddr_in))) panic("socket binding", errno);
 
-    io_service service;
+        if (listen(sockfd, 128)) panic("listen", errno);
+    }
+    fmt::print("Listening: {} on {} threads\n", (uint16_t) SERVER_PORT, rt.size());
 
-    // Start main coroutine ( for co_await )
-    service.run(accept_connection(service, sockfd, dirfd));
+    // Start main coroutines ( for co_await )
+    for (unsigned core = 0; core < rt.size(); ++core) {
+        rt.spawn_on(core, [sockfd = sockfds[core], dirfd](io_service& service) {
+            return accept_connection(service, sockfd, dirfd);
+        });
+    }
+    rt.run_until_stopped();
 }
@@ -2,7 +2,6 @@
 #include <fcntl.h>
 #include <sys/stat.h>
 #include <sys/ioctl.h>
-#include <vector>
 
 #include <liburing/io_service.hpp>
 
@@ -26,28 +25,29 @@ static off_t get_file_size(int fd) {
     throw std::runtime_error("Unsupported file type");
 }
 
-uio::task<> copy_file(uio::io_service& service, off_t insize) {
-    using uio::on_scope_exit;
-    using uio::to_iov;
+uio::task<> copy_file(uio::io_service& service, const uio::fixed_fd& in, const uio::fixed_fd& out, off_t insize) {
     using uio::panic_on_err;
 
-    std::vector<char> buf(BS, '\0');
-    service.register_buffers({ to_iov(buf.data(), buf.size()) });
-    on_scope_exit unreg_bufs([&]() { service.unregister_buffers(); });
+    // One small region is enough for a single block
+    uio::fixed_buffer_pool buffers(service, 64 * 1024, 1);
+    auto buf = buffers.acquire(BS);
 
     off_t offset = 0;
     for (; offset < insize - BS; offset += BS) {
-        service.read_fixed(0, buf.data(), buf.size(), offset, 0, IOSQE_FIXED_FILE | IOSQE_IO_LINK) | panic_on_err("read_fixed(1)", false);
-        service.write_fixed(1, buf.data(), buf.size(), offset, 0, IOSQE_FIXED_FILE | IOSQE_IO_LINK) | panic_on_err("write_fixed(1)", false);
+        service.read_fixed(in, buf, BS, offset, IOSQE_IO_LINK);
+        auto write = service.write_fixed(out, buf, BS, offset, IOSQE_IO_LINK) | panic_on_err("write_fixed(1)", false);
+        // A chain ends where the SQ is submitted. Let it finish before the buffer is reused by the next one
+        if (io_uring_sq_space_left(&service.get_handle()) < 2) co_await write;
     }
 
     int left = insize - offset;
     if (left)
     {
-        service.read_fixed(0, buf.data(), left, offset, 0, IOSQE_FIXED_FILE | IOSQE_IO_LINK) | panic_on_err("read_fixed(2)", false);
-        service.write_fixed(1, buf.data(), left, offset, 0, IOSQE_FIXED_FILE | IOSQE_IO_LINK) | panic_on_err("write_fixed(2)", false);
+        service.read_fixed(in, buf, left, offset, IOSQE_IO_LINK);
+        service.write_fixed(out, buf, left, offset, IOSQE_IO_LINK);
     }
-    co_await service.fsync(1, 0, IOSQE_FIXED_FILE);
+    // Linked ops aren't awaited: a failed one cancels the rest of its chain, down to the fsync
+    co_await service.fsync(out, 0) | panic_on_err("fsync", false);
 }
 
 int main(int argc, char *argv[]) {
@@ -68,8 +68,10 @@ int main(int argc, char *argv[]) {
 
     off_t insize = get_file_size(infd);
     io_service service;
-    service.register_files({ infd, outfd });
-    on_scope_exit unreg_file([&]() { service.unregister_files(); });
+    // Both files live in slots of the registered file table; the regular fds aren't used by the copy
+    uio::file_table files(service, 2);
+    auto in = files.install(infd);
+    auto out = files.install(outfd);
 
-    service.run(copy_file(service, insize));
+    service.run(copy_file(service, in, out, insize));
 }
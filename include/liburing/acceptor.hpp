@@ -0,0 +1,102 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+
+#include <liburing/runtime.hpp>
+
+namespace uio {
+/**
+ * Accepts connections on one ring and moves each socket into the registered file
+ * table of the least loaded worker of a runtime ( IORING_MSG_SEND_FD ). Workers get
+ * a direct descriptor without any syscall of their own.
+ * The load of a worker is the number of connections it's serving.
+ * @warning the acceptor must outlive the connections it hands out
+ */
+class acceptor {
+public:
+    /**
+     * @param service ring of the accepting thread, with a sparse file table ( register_files_sparse )
+     * @param workers runtime serving the connections, created with a sparse file table per ring
+     */
+    acceptor(io_service& service, runtime& workers)
+        : service(service), workers(workers), loads(new load_counter[workers.size()]) {}
+
+    acceptor(const acceptor&) = delete;
+    acceptor& operator =(const acceptor&) = delete;
+
+    /** Number of connections a worker is serving. Callable from any thread */
+    [[nodiscard]]
+    unsigned load(unsigned core) const noexcept {
+        return loads[core].value.load(std::memory_order_relaxed);
+    }
+
+    /** Accept connections on `sockfd` and spread them over the workers
+     * @param handler invoked as `handler(io_service&, int file_index)` on the chosen
+     *        worker, returns a task serving the connection through the registered
+     *        file. The slot is closed once the task finishes
+     * @return a task resolved to the error that stopped accepting
+     */
+    template <typename Handler>
+    task<int> serve(int sockfd, Handler handler) {
+        auto connections = service.multishot_accept_direct(sockfd);
+        while (true) {
+            int file_index = co_await connections.next();
+            if (file_index < 0) co_return file_index;
+            dispatch(unsigned(file_index), handler);
+        }
+    }
+
+private:
+    struct alignas(64) load_counter {
+        std::atomic<unsigned> value = 0;
+    };
+
+    template <typename Handler>
+    void dispatch(unsigned file_index, const Handler& handler) {
+        const unsigned core = least_loaded();
+        loads[core].value.fetch_add(1, std::memory_order_relaxed);
+
+        // Invoked on the worker with the slot installed there, or here with -errno if
+        // the file can't be sent
+        auto* resolver = callback_resolver::create([this, core, handler](int result) {
+            if (result < 0) {
+                loads[core].value.fetch_sub(1, std::memory_order_relaxed);
+                return;
+            }
+            [](acceptor& self, unsigned core, unsigned file_index, Handler handler) -> task<> {
+                auto& service = self.workers.service(core);
+                // Even if the handler throws
+                on_scope_exit release([&] {
+                    (void) service.close_direct(file_index, IOSQE_CQE_SKIP_SUCCESS);
+                    self.loads[core].value.fetch_sub(1, std::memory_order_relaxed);
+                });
+                co_await handler(service, int(file_index));
+            }(*this, core, unsigned(result), handler);
+        });
+        workers.send_file(service, core, file_index, resolver);
+    }
+
+    /** Ties are broken round-robin, so that idle workers are filled evenly */
+    unsigned least_loaded() noexcept {
+        const unsigned n = workers.size();
+        unsigned best = next;
+        unsigned best_load = load(best);
+        for (unsigned i = 1; i < n && best_load > 0; ++i) {
+            const unsigned core = (next + i) % n;
+            if (const unsigned l = load(core); l < best_load) {
+                best = core;
+                best_load = l;
+            }
+        }
+        next = (best + 1) % n;
+        return best;
+    }
+
+    io_service& service;
+    runtime& workers;
+    std::unique_ptr<load_counter[]> loads;
+    unsigned next = 0;
+};
+
+} // namespace uio
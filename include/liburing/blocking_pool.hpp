@@ -0,0 +1,179 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <coroutine>
+#include <cstdint>
+#include <exception>
+#include <optional>
+#include <semaphore>
+#include <thread>
+#include <type_traits>
+#include <variant>
+#include <vector>
+
+#include <liburing/io_service.hpp>
+#include <liburing/mpmc_queue.hpp>
+
+namespace uio {
+namespace detail {
+/** A call run by a worker of a blocking_pool, resolved on the ring of the caller */
+struct blocking_job: resolver {
+    virtual void run() noexcept = 0;
+
+    /** Ring the completion is posted to */
+    int ring_fd = -1;
+
+protected:
+    ~blocking_job() = default;
+};
+} // namespace detail
+
+/**
+ * Fixed threads running blocking calls ( getaddrinfo, compression, legacy APIs ) for
+ * coroutines, so that their rings keep going. Calls are queued lock-free, and their
+ * completion is posted back to the ring of the caller ( IORING_OP_MSG_RING ) from a
+ * private ring of the worker, which then resumes the caller on its own thread
+ * @note the pool must outlive the calls awaited on it
+ */
+class blocking_pool {
+public:
+    /** Start worker threads
+     * @param threads number of threads, 0 for one per CPU
+     * @param queue_size calls queued at most, a power of two. Calls beyond it run on the calling thread
+     */
+    explicit blocking_pool(unsigned threads = 0, size_t queue_size = 1024): queue(queue_size) {
+        if (threads == 0) threads = std::max(std::thread::hardware_concurrency(), 1u);
+        workers.reserve(threads);
+        for (unsigned i = 0; i < threads; ++i) {
+            workers.emplace_back([this] { work(); });
+        }
+    }
+
+    /** Stop and join all worker threads */
+    ~blocking_pool() noexcept {
+        stopping.store(true, std::memory_order_relaxed);
+        pending.release(std::ptrdiff_t(workers.size()));
+        for (auto& worker : workers) worker.join();
+    }
+
+    blocking_pool(const blocking_pool&) = delete;
+    blocking_pool& operator =(const blocking_pool&) = delete;
+
+    /** Awaitable of invoke() */
+    template <typename Fn>
+    class [[nodiscard]] call final: detail::blocking_job {
+    public:
+        using result_type = std::invoke_result_t<Fn&>;
+
+        call(blocking_pool& pool, io_service& service, Fn fn): pool(pool), service(service), fn(std::move(fn)) {}
+
+        bool await_ready() const noexcept { return false; }
+
+        bool await_suspend(std::coroutine_handle<> handle) noexcept {
+            this->handle = handle;
+            ring_fd = service.get_handle().ring_fd;
+            if (pool.submit(this)) return true;
+            // Queue full: block the caller, as a plain blocking call would
+            puts_if_verbose(__FILE__ ": blocking_pool queue is full, running the call inline");
+            run();
+            return false;
+        }
+
+        result_type await_resume() {
+            if constexpr (!noexcept(fn())) {
+                if (result.index() == 2) std::rethrow_exception(std::get<2>(result));
+            }
+            if constexpr (!std::is_void_v<result_type>) {
+                return std::move(std::get<1>(result));
+            }
+        }
+
+    private:
+        using value_type = std::conditional_t<std::is_void_v<result_type>, std::monostate, result_type>;
+
+        void run() noexcept override {
+            auto invoke = [this] {
+                if constexpr (std::is_void_v<result_type>) {
+                    fn();
+                    result.template emplace<1>();
+                } else {
+                    result.template emplace<1>(fn());
+                }
+            };
+            if constexpr (noexcept(fn())) {
+                invoke();
+            } else {
+                try {
+                    invoke();
+                } catch (...) {
+                    result.template emplace<2>(std::current_exception());
+                }
+            }
+        }
+
+        void resolve(int, uint32_t) noexcept override {
+            handle.resume();
+        }
+
+        blocking_pool& pool;
+        io_service& service;
+        Fn fn;
+        std::coroutine_handle<> handle;
+        std::variant<
+            std::monostate,
+            value_type,
+            std::conditional_t<noexcept(std::declval<Fn&>()()), std::monostate, std::exception_ptr>
+        > result;
+    };
+
+    /** Invoke `fn()` on a worker thread
+     * @param service ring of the calling coroutine, which it's resumed on
+     * @return an awaitable resolved to the result of `fn()`, or rethrowing what it throws
+     */
+    template <typename Fn>
+    [[nodiscard]]
+    call<std::decay_t<Fn>> invoke(io_service& service, Fn&& fn) {
+        return { *this, service, std::forward<Fn>(fn) };
+    }
+
+    /** Number of worker threads */
+    [[nodiscard]]
+    unsigned size() const noexcept {
+        return unsigned(workers.size());
+    }
+
+private:
+    bool submit(detail::blocking_job* job) noexcept {
+        if (!queue.push(job)) return false;
+        pending.release();
+        return true;
+    }
+
+    void work() {
+        detail::messenger messenger;
+        for (;;) {
+            pending.acquire();
+            std::optional<detail::blocking_job*> popped;
+            // A permit means a job is queued, though the push may not be visible yet
+            while (!(popped = queue.pop())) {
+                if (stopping.load(std::memory_order_relaxed)) return;
+                std::this_thread::yield();
+            }
+            auto* job = *popped;
+            job->run();
+            // The caller may be resumed, and the job gone, as soon as the message is posted
+            const int fd = job->ring_fd;
+            messenger.post(fd, to_user_data<resolver>(job));
+        }
+    }
+
+    detail::mpmc_queue<detail::blocking_job*> queue;
+    /** One permit per queued job, plus one per worker once stopping */
+    std::counting_semaphore<> pending { 0 };
+    std::atomic<bool> stopping = false;
+    std::vector<std::thread> workers;
+};
+
+} // namespace uio
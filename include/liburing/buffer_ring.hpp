@@ -0,0 +1,253 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <utility>
+#include <liburing.h>   // http://git.kernel.dk/liburing
+
+#include <liburing/io_service.hpp>
+
+namespace uio {
+struct multishot_resolver;
+
+/**
+ * A buffer picked by the kernel from a buffer_ring
+ * The buffer is given back to its ring when the lease is released or destructed
+ */
+struct buffer_lease {
+    /** Only for placeholder */
+    buffer_lease() noexcept = default;
+
+    buffer_lease(buffer_ring* ring, char* data, int result, uint16_t bid) noexcept
+        : ring(ring), buf(data), res(result), id(bid) {}
+
+    buffer_lease(const buffer_lease&) = delete;
+    buffer_lease& operator =(const buffer_lease&) = delete;
+
+    buffer_lease(buffer_lease&& other) noexcept
+        : ring(std::exchange(other.ring, nullptr))
+        , buf(std::exchange(other.buf, nullptr))
+        , res(other.res)
+        , id(other.id) {}
+
+    buffer_lease& operator =(buffer_lease&& other) noexcept {
+        if (this != &other) {
+            release();
+            ring = std::exchange(other.ring, nullptr);
+            buf = std::exchange(other.buf, nullptr);
+            res = other.res;
+            id = other.id;
+        }
+        return *this;
+    }
+
+    ~buffer_lease() noexcept {
+        release();
+    }
+
+    /** Give the buffer back to its ring. The lease is empty afterwards */
+    void release() noexcept;
+
+    /** Pointer to the data filled by the kernel, or nullptr if no buffer was picked */
+    [[nodiscard]]
+    char* data() const noexcept { return buf; }
+
+    /** Number of bytes filled by the kernel */
+    [[nodiscard]]
+    unsigned size() const noexcept { return res > 0 ? unsigned(res) : 0; }
+
+    /** Buffer id in the buffer ring */
+    [[nodiscard]]
+    uint16_t bid() const noexcept { return id; }
+
+    /** Return value of the operation: bytes transferred, 0 on EOF, or -errno on failure
+     * @note -ENOBUFS is returned when the ring runs out of buffers
+     */
+    [[nodiscard]]
+    int result() const noexcept { return res; }
+
+    /** Whether the lease holds a buffer */
+    explicit operator bool() const noexcept { return buf != nullptr; }
+
+private:
+    buffer_ring* ring = nullptr;
+    char* buf = nullptr;
+    int res = 0;
+    uint16_t id = 0;
+};
+
+/**
+ * A provided buffer ring registered on an io_service
+ * Operations issued with IOSQE_BUFFER_SELECT let the kernel pick a buffer only
+ * when data arrives, so memory grows with active reads instead of pending ones.
+ */
+class buffer_ring {
+public:
+    /** Allocate and register a provided buffer ring
+     * @see io_uring_register(2) IORING_REGISTER_PBUF_RING
+     * @param service io_service to register the ring on
+     * @param bgid buffer group id, unique per io_service
+     * @param entries number of buffers, must be a power of 2 and not greater than 32768
+     * @param buf_size size of each buffer
+     */
+    buffer_ring(io_service& service, uint16_t bgid, unsigned entries, unsigned buf_size)
+        : ring(service.get_handle())
+        , group(bgid)
+        , entries(entries)
+        , buf_size(buf_size)
+        , storage(new char[size_t(entries) * buf_size]) {
+        int ret = 0;
+        br = io_uring_setup_buf_ring(&ring, entries, bgid, 0, &ret);
+        if (!br) panic("io_uring_setup_buf_ring", -ret);
+
+        for (unsigned i = 0; i < entries; ++i) {
+            io_uring_buf_ring_add(br, buffer(uint16_t(i)), buf_size, uint16_t(i), io_uring_buf_ring_mask(entries), int(i));
+        }
+        io_uring_buf_ring_advance(br, int(entries));
+        free_count = entries;
+    }
+
+    /** Unregister and free the buffer ring
+     * @note all leases must be released before
+     */
+    ~buffer_ring() noexcept {
+        io_uring_free_buf_ring(&ring, br, entries, group);
+    }
+
+    buffer_ring(const buffer_ring&) = delete;
+    buffer_ring& operator =(const buffer_ring&) = delete;
+
+    /** Buffer group id, set to sqe->buf_group */
+    [[nodiscard]]
+    uint16_t bgid() const noexcept { return group; }
+
+    /** Size of each buffer */
+    [[nodiscard]]
+    unsigned buffer_size() const noexcept { return buf_size; }
+
+    /** Number of buffers the kernel can still pick */
+    [[nodiscard]]
+    unsigned available() const noexcept { return free_count; }
+
+    /** Account for the buffer picked by a cqe, as soon as the cqe is reaped,
+     * so that available() doesn't count buffers of cqes not consumed yet
+     * @param cqe_flags cqe->flags, IORING_CQE_F_BUFFER is set if a buffer was picked
+     */
+    void take(uint32_t cqe_flags) noexcept {
+        if (cqe_flags & IORING_CQE_F_BUFFER) --free_count;
+    }
+
+    /** Wrap the buffer reported by a cqe, take()n already
+     * @param result cqe->res
+     * @param cqe_flags cqe->flags, IORING_CQE_F_BUFFER is set if a buffer was picked
+     * @return a lease owning the picked buffer, or an empty lease holding `result` only
+     */
+    buffer_lease lease(int result, uint32_t cqe_flags) noexcept {
+        if (!(cqe_flags & IORING_CQE_F_BUFFER)) return buffer_lease(nullptr, nullptr, result, 0);
+        auto bid = uint16_t(cqe_flags >> IORING_CQE_BUFFER_SHIFT);
+        return buffer_lease(this, buffer(bid), result, bid);
+    }
+
+    /** Give a buffer back to the kernel */
+    void recycle(uint16_t bid) noexcept {
+        io_uring_buf_ring_add(br, buffer(bid), buf_size, bid, io_uring_buf_ring_mask(entries), 0);
+        io_uring_buf_ring_advance(br, 1);
+        ++free_count;
+        if (!starved.empty()) wake_starved();
+    }
+
+    /** Park a multishot request ended with -ENOBUFS until a buffer is given back */
+    void wait_for_buffer(multishot_resolver* resolver) {
+        starved.push_back(resolver);
+    }
+
+    /** Forget a parked multishot request */
+    void cancel_wait(multishot_resolver* resolver) noexcept {
+        std::erase(starved, resolver);
+    }
+
+private:
+    void wake_starved() noexcept;
+
+    char* buffer(uint16_t bid) const noexcept {
+        return storage.get() + size_t(bid) * buf_size;
+    }
+
+    io_uring& ring;
+    io_uring_buf_ring* br = nullptr;
+    uint16_t group;
+    unsigned entries;
+    unsigned buf_size;
+    unsigned free_count = 0;
+    std::unique_ptr<char[]> storage;
+    std::deque<multishot_resolver*> starved;
+};
+
+inline void buffer_lease::release() noexcept {
+    if (ring) {
+        ring->recycle(id);
+        ring = nullptr;
+        buf = nullptr;
+    }
+}
+
+struct buffer_awaitable {
+    buffer_awaitable(io_uring_sqe* sqe, buffer_ring& buffers) noexcept: sqe(sqe), buffers(&buffers) {}
+
+    auto operator co_await() {
+        struct await_buffer {
+            resume_resolver resolver {};
+            io_uring_sqe* sqe;
+            buffer_ring* buffers;
+
+            await_buffer(io_uring_sqe* sqe, buffer_ring* buffers): sqe(sqe), buffers(buffers) {}
+
+            constexpr bool await_ready() const noexcept { return false; }
+
+            void await_suspend(std::coroutine_handle<> handle) noexcept {
+                resolver.handle = handle;
+                set_resolver(sqe, &resolver);
+            }
+
+            buffer_lease await_resume() const noexcept {
+                buffers->take(resolver.flags);
+                return buffers->lease(resolver.result, resolver.flags);
+            }
+        };
+
+        return await_buffer(sqe, buffers);
+    }
+
+private:
+    io_uring_sqe* sqe;
+    buffer_ring* buffers;
+};
+
+inline buffer_awaitable io_service::read(
+    int fd,
+    buffer_ring& buffers,
+    off_t offset,
+    uint8_t iflags
+) noexcept {
+    auto* sqe = io_uring_get_sqe_safe();
+    io_uring_prep_read(sqe, fd, nullptr, buffers.buffer_size(), offset);
+    sqe->buf_group = buffers.bgid();
+    io_uring_sqe_set_flags(sqe, iflags | IOSQE_BUFFER_SELECT);
+    return buffer_awaitable(sqe, buffers);
+}
+
+inline buffer_awaitable io_service::recv(
+    int sockfd,
+    buffer_ring& buffers,
+    uint32_t flags,
+    uint8_t iflags
+) noexcept {
+    auto* sqe = io_uring_get_sqe_safe();
+    io_uring_prep_recv(sqe, sockfd, nullptr, buffers.buffer_size(), int(flags));
+    sqe->buf_group = buffers.bgid();
+    io_uring_sqe_set_flags(sqe, iflags | IOSQE_BUFFER_SELECT);
+    return buffer_awaitable(sqe, buffers);
+}
+
+} // namespace uio
@@ -0,0 +1,241 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <coroutine>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <utility>
+
+#include <liburing/io_service.hpp>
+#include <liburing/mpmc_queue.hpp>
+
+namespace uio {
+/**
+ * Bounded channel passing values between coroutines of different rings, possibly on
+ * different threads: many producers, one consumer. Values go through a lock-free ring
+ * buffer; IORING_OP_MSG_RING is only used to wake up a side that parked itself, sent
+ * from the ring of the other side. A consumer that keeps up never parks, so the
+ * producers don't make any syscall for it.
+ * The waking side completes the operation of the parked one first, pushing or popping
+ * its value, so that a wake-up only has to resume the coroutine
+ * @see io_uring_enter(2) IORING_OP_MSG_RING
+ */
+template <typename T>
+class channel {
+public:
+    /** @param capacity values buffered at most, a power of two */
+    explicit channel(size_t capacity = 1024): queue(capacity) {}
+
+    ~channel() noexcept {
+        assert(!consumer.load(std::memory_order_relaxed) && !producers && "channel destroyed with waiters");
+    }
+
+    channel(const channel&) = delete;
+    channel& operator =(const channel&) = delete;
+
+    /** Awaitable of send(), parked while the channel is full */
+    class [[nodiscard]] send_awaitable final {
+    public:
+        send_awaitable(channel& ch, io_service& service, T&& value): ch(ch), service(service), value(std::move(value)) {}
+
+        bool await_ready() {
+            return ch.push(service, value);
+        }
+
+        bool await_suspend(std::coroutine_handle<> handle) {
+            waker.handle = handle;
+            ring_fd = service.get_handle().ring_fd;
+            return ch.park_producer(service, this);
+        }
+
+        constexpr void await_resume() const noexcept {}
+
+    private:
+        friend class channel;
+
+        channel& ch;
+        io_service& service;
+        T value;
+        /** Resumed by the consumer once it pushed `value` */
+        resume_resolver waker;
+        int ring_fd = -1;
+        send_awaitable* next = nullptr;
+    };
+
+    /** Awaitable of recv(), parked while the channel is empty */
+    class [[nodiscard]] recv_awaitable final {
+    public:
+        recv_awaitable(channel& ch, io_service& service) noexcept: ch(ch), service(service) {}
+
+        bool await_ready() {
+            return (value = ch.pop(service)).has_value();
+        }
+
+        bool await_suspend(std::coroutine_handle<> handle) {
+            waker.handle = handle;
+            ring_fd = service.get_handle().ring_fd;
+            return park();
+        }
+
+        T await_resume() {
+            return std::move(*value);
+        }
+
+    private:
+        friend class channel;
+
+        /** @return whether the consumer is parked, waiting for a producer to pop a value into `value` */
+        bool park() {
+            for (;;) {
+                if ((value = ch.pop(service))) return false;
+                assert(!ch.consumer.load(std::memory_order_relaxed) && "channel has one consumer only");
+                if (ch.park_consumer(this)) return true;
+            }
+        }
+
+        channel& ch;
+        io_service& service;
+        std::optional<T> value;
+        /** Resumed by a producer once it filled `value` */
+        resume_resolver waker;
+        int ring_fd = -1;
+    };
+
+    /** Send a value, waiting for room if the channel is full
+     * @param service ring of the calling coroutine
+     * @return an awaitable resumed once the value is in the channel
+     */
+    [[nodiscard]]
+    send_awaitable send(io_service& service, T value) {
+        return { *this, service, std::move(value) };
+    }
+
+    /** Receive a value, waiting for one if the channel is empty
+     * @param service ring of the calling coroutine, the only consumer
+     * @return an awaitable resolved to the value
+     */
+    [[nodiscard]]
+    recv_awaitable recv(io_service& service) noexcept {
+        return { *this, service };
+    }
+
+    /** Send a value if there is room
+     * @return false if the channel is full, `value` is left untouched then
+     */
+    bool try_send(io_service& service, T&& value) {
+        return push(service, value);
+    }
+
+    /** Receive a value if there is one */
+    std::optional<T> try_recv(io_service& service) {
+        return pop(service);
+    }
+
+    [[nodiscard]]
+    size_t capacity() const noexcept {
+        return queue.capacity();
+    }
+
+private:
+    bool push(io_service& service, T& value) {
+        if (!queue.push(value)) return false;
+        notify_consumer(service);
+        return true;
+    }
+
+    std::optional<T> pop(io_service& service) {
+        auto value = queue.pop();
+        if (value) notify_producer(service);
+        return value;
+    }
+
+    /** Wake a parked side up through the ring of the caller, right away: it may have nothing else to submit */
+    static void wake(io_service& service, int ring_fd, resume_resolver* waker) noexcept {
+        (void) service.msg_ring(ring_fd, 0, to_user_data(waker), 0, IOSQE_CQE_SKIP_SUCCESS);
+        service.submit();
+    }
+
+    /** Publish the consumer as parked, unless values are there
+     * @return whether it's parked: woken up by whoever takes it back, not by the caller
+     */
+    bool park_consumer(recv_awaitable* waiter) noexcept {
+        consumer.store(waiter, std::memory_order_release);
+        // Pairs with the fence of notify_consumer: either the producer sees the consumer, or it sees the value
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (queue.empty()) return true;
+        // A value came meanwhile. Take the consumer back, unless a producer is receiving for it already
+        return consumer.exchange(nullptr, std::memory_order_acq_rel) != waiter;
+    }
+
+    /** Receive a value for the parked consumer, then wake it up */
+    void notify_consumer(io_service& service) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!consumer.load(std::memory_order_relaxed)) return;
+
+        auto* waiter = consumer.exchange(nullptr, std::memory_order_acq_rel);
+        while (waiter) {
+            if ((waiter->value = pop(service))) {
+                wake(service, waiter->ring_fd, &waiter->waker);
+                return;
+            }
+            // The head is still being pushed: park the consumer again, that producer wakes it up
+            if (park_consumer(waiter)) return;
+        }
+    }
+
+    /** Push the value of the first parked producer into the slot just freed, then wake it up */
+    void notify_producer(io_service& service) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!blocked.load(std::memory_order_relaxed)) return;
+
+        send_awaitable* waiter;
+        {
+            std::lock_guard lock(mutex);
+            // Another producer may have taken the slot; the next pop notifies again then
+            if (!producers || !queue.push(producers->value)) return;
+            waiter = std::exchange(producers, producers->next);
+            if (!producers) producers_tail = nullptr;
+            blocked.fetch_sub(1, std::memory_order_relaxed);
+        }
+        notify_consumer(service);
+        wake(service, waiter->ring_fd, &waiter->waker);
+    }
+
+    /** Push the value of `waiter`, or queue it up for a wake-up
+     * @return whether the producer is parked
+     */
+    bool park_producer(io_service& service, send_awaitable* waiter) {
+        {
+            std::lock_guard lock(mutex);
+            // Pairs with the fence of notify_producer: either the consumer sees the producer, or it sees the room
+            blocked.fetch_add(1, std::memory_order_seq_cst);
+            if (!queue.push(waiter->value)) {
+                waiter->next = nullptr;
+                if (producers_tail) {
+                    producers_tail->next = waiter;
+                } else {
+                    producers = waiter;
+                }
+                producers_tail = waiter;
+                return true;
+            }
+            blocked.fetch_sub(1, std::memory_order_relaxed);
+        }
+        notify_consumer(service);
+        return false;
+    }
+
+    detail::mpmc_queue<T> queue;
+    /** The consumer if it's parked */
+    alignas(64) std::atomic<recv_awaitable*> consumer = nullptr;
+    /** Producers parked, or about to; read without the lock by the consumer */
+    alignas(64) std::atomic<size_t> blocked = 0;
+    /** FIFO of parked producers, slow path only */
+    std::mutex mutex;
+    send_awaitable* producers = nullptr;
+    send_awaitable* producers_tail = nullptr;
+};
+
+} // namespace uio
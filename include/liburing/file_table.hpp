@@ -0,0 +1,326 @@
+#pragma once
+
+#include <cassert>
+#include <cerrno>
+#include <utility>
+#include <vector>
+#include <liburing.h>   // http://git.kernel.dk/liburing
+
+#include <liburing/io_service.hpp>
+
+namespace uio {
+class file_table;
+
+namespace detail {
+/** Closes in flight of a file_table. It outlives the table until the last one completes */
+struct pending_closes {
+    /** Null once the table is gone */
+    file_table* table;
+    unsigned count = 0;
+};
+} // namespace detail
+
+/**
+ * A slot of a file_table holding a direct descriptor
+ * The slot is closed and given back to its table when the object is reset or destructed.
+ * Operations of io_service taking a fixed_fd set IOSQE_FIXED_FILE for it
+ */
+class fixed_fd {
+public:
+    /** Only for placeholder */
+    fixed_fd() noexcept = default;
+
+    fixed_fd(file_table& table, unsigned index) noexcept: table(&table), slot(int(index)) {}
+
+    /** A failed one, holding -errno */
+    explicit fixed_fd(int error) noexcept: slot(error) {
+        assert(error < 0);
+    }
+
+    fixed_fd(const fixed_fd&) = delete;
+    fixed_fd& operator =(const fixed_fd&) = delete;
+
+    fixed_fd(fixed_fd&& other) noexcept
+        : table(std::exchange(other.table, nullptr))
+        , slot(std::exchange(other.slot, -EBADF)) {}
+
+    fixed_fd& operator =(fixed_fd&& other) noexcept {
+        if (this != &other) {
+            reset();
+            table = std::exchange(other.table, nullptr);
+            slot = std::exchange(other.slot, -EBADF);
+        }
+        return *this;
+    }
+
+    ~fixed_fd() noexcept {
+        reset();
+    }
+
+    /** Slot in the registered file table, or -errno if it failed to open */
+    [[nodiscard]]
+    int index() const noexcept { return slot; }
+
+    explicit operator bool() const noexcept { return slot >= 0; }
+
+    /** Close the slot ( IORING_OP_CLOSE, not awaited ). It's given back to the table once closed */
+    inline void reset() noexcept;
+
+    /** Give up the slot without closing it, e.g. once it's sent to another ring
+     * @return the slot, which must be closed with io_service::close_direct and
+     *         returned with file_table::deallocate by the caller
+     */
+    unsigned release() noexcept {
+        assert(slot >= 0);
+        table = nullptr;
+        return unsigned(std::exchange(slot, -EBADF));
+    }
+
+private:
+    file_table* table = nullptr;
+    int slot = -EBADF;
+};
+
+/** Awaitable of the operations of file_table, resolved to a fixed_fd */
+struct fixed_fd_awaitable {
+    /** @param slot slot the operation installs the file into, or -errno if none is free */
+    fixed_fd_awaitable(io_uring_sqe* sqe, file_table& table, int slot) noexcept: sqe(sqe), table(&table), slot(slot) {}
+
+    struct awaiter {
+        resume_resolver resolver {};
+        io_uring_sqe* sqe;
+        file_table* table;
+        int slot;
+
+        awaiter(io_uring_sqe* sqe, file_table* table, int slot): sqe(sqe), table(table), slot(slot) {}
+
+        bool await_ready() const noexcept { return slot < 0; }
+
+        void await_suspend(std::coroutine_handle<> handle) noexcept {
+            resolver.handle = handle;
+            set_resolver(sqe, &resolver);
+        }
+
+        // Defined along with file_table
+        inline fixed_fd await_resume() const noexcept;
+    };
+
+    awaiter operator co_await() {
+        return awaiter(sqe, table, slot);
+    }
+
+private:
+    io_uring_sqe* sqe;
+    file_table* table;
+    int slot;
+};
+
+/**
+ * Manager of the registered file table of an io_service ( IORING_RSRC_REGISTER_SPARSE )
+ * Slots are handed out from a freelist in O(1), and files are opened, accepted or created
+ * straight into them ( direct descriptors ), so that they never take a regular fd.
+ * Operations on a fixed_fd skip the fget/fput of the file per operation.
+ * @note the table replaces whatever is registered with register_files
+ */
+class file_table {
+public:
+    /** Register a sparse file table
+     * @param service ring to register the table on
+     * @param size number of slots
+     * @param reserved slots at the end of the table left to the kernel for
+     *        IORING_FILE_INDEX_ALLOC ( multishot_accept_direct, send_fd of other rings );
+     *        wrap the slots they yield with adopt()
+     * @see io_uring_register(2) IORING_REGISTER_FILES2 IORING_REGISTER_FILE_ALLOC_RANGE
+     */
+    file_table(io_service& service, unsigned size, unsigned reserved = 0)
+        : service(service), managed(size - reserved) {
+        assert(reserved <= size);
+        service.register_files_sparse(size);
+        auto& ring = service.get_handle();
+        io_uring_register_file_alloc_range(&ring, managed, reserved) | panic_on_err("io_uring_register_file_alloc_range", false);
+
+        // Lowest slots are handed out first
+        free_slots.reserve(managed);
+        for (unsigned i = managed; i > 0; --i) free_slots.push_back(i - 1);
+        closes = new detail::pending_closes { this };
+    }
+
+    /** Unregister the table, closing everything left in it
+     * Closes still in flight complete later, they give their slots back to nothing
+     */
+    ~file_table() noexcept {
+        assert(in_use == closes->count && "A fixed_fd outlives its file_table");
+        if (closes->count > 0) {
+            closes->table = nullptr;
+            // Issued now, so that they close slots of this table rather than of the next one registered
+            service.submit();
+        } else {
+            delete closes;
+        }
+        service.unregister_files();
+    }
+
+    file_table(const file_table&) = delete;
+    file_table& operator =(const file_table&) = delete;
+
+    /** Take an empty slot
+     * @return the slot, or -ENFILE if there is none left
+     */
+    [[nodiscard]]
+    int allocate() noexcept {
+        if (free_slots.empty()) return -ENFILE;
+        ++in_use;
+        const unsigned index = free_slots.back();
+        free_slots.pop_back();
+        return int(index);
+    }
+
+    /** Give an empty slot back, either from allocate() or one the kernel allocated */
+    void deallocate(unsigned index) noexcept {
+        --in_use;
+        // Slots the kernel allocates are its business
+        if (index < managed) free_slots.push_back(index);
+    }
+
+    /** Take ownership of a slot the kernel filled ( IORING_FILE_INDEX_ALLOC ) */
+    fixed_fd adopt(unsigned index) noexcept {
+        ++in_use;
+        return fixed_fd(*this, index);
+    }
+
+    /** Close a slot asynchronously and give it back once the close completes:
+     * a file installed into it earlier would be closed instead */
+    void close(unsigned index) {
+        ++closes->count;
+        service.close_direct(index).set_callback([closes = closes, index](int) {
+            if (closes->table) closes->table->deallocate(index);
+            if (--closes->count == 0 && !closes->table) delete closes;
+        });
+    }
+
+    /** Install a regular fd into a slot ( IORING_REGISTER_FILES_UPDATE )
+     * The table holds its own reference, `fd` may be closed afterwards
+     * @return the slot, or a fixed_fd holding -ENFILE
+     */
+    fixed_fd install(int fd) {
+        const int index = allocate();
+        if (index < 0) return fixed_fd(index);
+        service.register_files_update(unsigned(index), &fd, 1);
+        return fixed_fd(*this, unsigned(index));
+    }
+
+    /** Open and possibly create a file into a slot asynchronously
+     * @see openat(2)
+     * @see io_uring_enter(2) IORING_OP_OPENAT
+     * @param iflags IOSQE_* flags
+     * @return an awaitable resolved to the fixed_fd
+     */
+    fixed_fd_awaitable openat(
+        int dfd,
+        const char *path,
+        int flags,
+        mode_t mode,
+        uint8_t iflags = 0
+    ) noexcept {
+        return prepare(iflags, [&](io_uring_sqe* sqe, unsigned index) {
+            io_uring_prep_openat_direct(sqe, dfd, path, flags, mode, index);
+        });
+    }
+
+    /** Accept a connection into a slot asynchronously
+     * @see accept4(2)
+     * @see io_uring_enter(2) IORING_OP_ACCEPT
+     * @param iflags IOSQE_* flags
+     * @return an awaitable resolved to the fixed_fd
+     */
+    fixed_fd_awaitable accept(
+        int fd,
+        sockaddr *addr,
+        socklen_t *addrlen,
+        int flags = 0,
+        uint8_t iflags = 0
+    ) noexcept {
+        return prepare(iflags, [&](io_uring_sqe* sqe, unsigned index) {
+            io_uring_prep_accept_direct(sqe, fd, addr, addrlen, flags, index);
+        });
+    }
+
+    /** Create a socket into a slot asynchronously
+     * @see socket(2)
+     * @see io_uring_enter(2) IORING_OP_SOCKET
+     * @param iflags IOSQE_* flags
+     * @return an awaitable resolved to the fixed_fd
+     */
+    fixed_fd_awaitable socket(
+        int domain,
+        int type,
+        int protocol,
+        uint8_t iflags = 0
+    ) noexcept {
+        return prepare(iflags, [&](io_uring_sqe* sqe, unsigned index) {
+            io_uring_prep_socket_direct(sqe, domain, type, protocol, index, 0);
+        });
+    }
+
+    /** Number of slots handed out, including the ones being closed */
+    [[nodiscard]]
+    unsigned size() const noexcept { return in_use; }
+
+private:
+    /** Prepare an operation installing a file into a free slot. Without one, nothing is submitted */
+    template <typename Prep>
+    fixed_fd_awaitable prepare(uint8_t iflags, Prep&& prep) noexcept {
+        const int index = allocate();
+        if (index < 0) return fixed_fd_awaitable(nullptr, *this, index);
+
+        auto* sqe = service.io_uring_get_sqe_safe();
+        prep(sqe, unsigned(index));
+        io_uring_sqe_set_flags(sqe, iflags);
+        return fixed_fd_awaitable(sqe, *this, index);
+    }
+
+    io_service& service;
+    /** Slots [0, managed) are handed out by the freelist, the rest by the kernel */
+    const unsigned managed;
+    std::vector<unsigned> free_slots;
+    unsigned in_use = 0;
+    /** Slots whose close is in flight */
+    detail::pending_closes* closes = nullptr;
+};
+
+inline void fixed_fd::reset() noexcept {
+    if (slot >= 0) table->close(unsigned(slot));
+    table = nullptr;
+    slot = -EBADF;
+}
+
+inline fixed_fd fixed_fd_awaitable::awaiter::await_resume() const noexcept {
+    if (slot < 0) return fixed_fd(slot);
+    if (resolver.result < 0) {
+        table->deallocate(unsigned(slot));
+        return fixed_fd(resolver.result);
+    }
+    return fixed_fd(*table, unsigned(slot));
+}
+
+#define FIXED_FD_OP(name, prep, params, ...) \
+inline sqe_awaitable io_service::name params noexcept { \
+    assert(fd && "The file isn't open"); \
+    auto* sqe = io_uring_get_sqe_safe(); \
+    prep(sqe, fd.index(), __VA_ARGS__); \
+    return await_work(sqe, iflags | IOSQE_FIXED_FILE); \
+}
+FIXED_FD_OP(readv, io_uring_prep_readv, (const fixed_fd& fd, const iovec* iovecs, unsigned nr_vecs, off_t offset, uint8_t iflags), iovecs, nr_vecs, offset)
+FIXED_FD_OP(writev, io_uring_prep_writev, (const fixed_fd& fd, const iovec* iovecs, unsigned nr_vecs, off_t offset, uint8_t iflags), iovecs, nr_vecs, offset)
+FIXED_FD_OP(read, io_uring_prep_read, (const fixed_fd& fd, void* buf, unsigned nbytes, off_t offset, uint8_t iflags), buf, nbytes, offset)
+FIXED_FD_OP(write, io_uring_prep_write, (const fixed_fd& fd, const void* buf, unsigned nbytes, off_t offset, uint8_t iflags), buf, nbytes, offset)
+FIXED_FD_OP(read_fixed, io_uring_prep_read_fixed, (const fixed_fd& fd, void* buf, unsigned nbytes, off_t offset, int buf_index, uint8_t iflags), buf, nbytes, offset, buf_index)
+FIXED_FD_OP(write_fixed, io_uring_prep_write_fixed, (const fixed_fd& fd, const void* buf, unsigned nbytes, off_t offset, int buf_index, uint8_t iflags), buf, nbytes, offset, buf_index)
+FIXED_FD_OP(fsync, io_uring_prep_fsync, (const fixed_fd& fd, unsigned fsync_flags, uint8_t iflags), fsync_flags)
+FIXED_FD_OP(recv, io_uring_prep_recv, (const fixed_fd& fd, void* buf, unsigned nbytes, uint32_t flags, uint8_t iflags), buf, nbytes, int(flags))
+FIXED_FD_OP(send, io_uring_prep_send, (const fixed_fd& fd, const void* buf, unsigned nbytes, uint32_t flags, uint8_t iflags), buf, nbytes, int(flags))
+FIXED_FD_OP(connect, io_uring_prep_connect, (const fixed_fd& fd, sockaddr *addr, socklen_t addrlen, int, uint8_t iflags), addr, addrlen)
+FIXED_FD_OP(shutdown, io_uring_prep_shutdown, (const fixed_fd& fd, int how, uint8_t iflags), how)
+#undef FIXED_FD_OP
+
+} // namespace uio
@@ -0,0 +1,267 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include <sys/mman.h>
+#include <liburing.h>   // http://git.kernel.dk/liburing
+
+#include <liburing/io_service.hpp>
+
+namespace uio {
+class fixed_buffer_pool;
+
+/**
+ * A block of registered memory taken from a fixed_buffer_pool
+ * The block is given back to its pool when the lease is released or destructed
+ */
+class fixed_buffer {
+public:
+    /** Only for placeholder */
+    fixed_buffer() noexcept = default;
+
+    fixed_buffer(fixed_buffer_pool* pool, char* data, uint32_t size, uint16_t buf_index, uint8_t size_class) noexcept
+        : pool(pool), buf(data), len(size), index(buf_index), cls(size_class) {}
+
+    fixed_buffer(const fixed_buffer&) = delete;
+    fixed_buffer& operator =(const fixed_buffer&) = delete;
+
+    fixed_buffer(fixed_buffer&& other) noexcept
+        : pool(std::exchange(other.pool, nullptr))
+        , buf(std::exchange(other.buf, nullptr))
+        , len(other.len)
+        , index(other.index)
+        , cls(other.cls) {}
+
+    fixed_buffer& operator =(fixed_buffer&& other) noexcept {
+        if (this != &other) {
+            release();
+            pool = std::exchange(other.pool, nullptr);
+            buf = std::exchange(other.buf, nullptr);
+            len = other.len;
+            index = other.index;
+            cls = other.cls;
+        }
+        return *this;
+    }
+
+    ~fixed_buffer() noexcept {
+        release();
+    }
+
+    [[nodiscard]]
+    char* data() const noexcept { return buf; }
+
+    /** Capacity of the block, at least what was asked for */
+    [[nodiscard]]
+    uint32_t size() const noexcept { return len; }
+
+    /** Index of the registered buffer holding the block, for IORING_OP_READ_FIXED / WRITE_FIXED */
+    [[nodiscard]]
+    uint16_t buf_index() const noexcept { return index; }
+
+    explicit operator bool() const noexcept { return buf != nullptr; }
+
+    /** Give the block back to its pool */
+    inline void release() noexcept;
+
+private:
+    fixed_buffer_pool* pool = nullptr;
+    char* buf = nullptr;
+    uint32_t len = 0;
+    uint16_t index = 0;
+    uint8_t cls = 0;
+};
+
+/**
+ * Registered memory for read_fixed / write_fixed, split into power-of-two size classes
+ * Memory comes in regions, each one a registered buffer, carved into slabs of a
+ * size class on demand. The buffer table is registered sparse up front
+ * ( IORING_REGISTER_BUFFERS2 ), so regions are added as the pool grows
+ * ( IORING_REGISTER_BUFFERS_UPDATE ) without re-registering the others
+ * @note the pool replaces whatever is registered with register_buffers
+ */
+class fixed_buffer_pool {
+public:
+    static constexpr uint32_t min_block = 4096;
+    /** Blocks of a class are carved from the current region this many bytes at a time, at least,
+     * or a whole region if regions are smaller */
+    static constexpr uint32_t slab_size = 64 * 1024;
+
+    /**
+     * @param service ring to register the memory on
+     * @param region_size bytes mapped and registered at a time, also the largest block
+     * @param max_regions slots of the registered buffer table
+     * @see io_uring_register(2) IORING_REGISTER_BUFFERS2 IORING_RSRC_REGISTER_SPARSE
+     */
+    fixed_buffer_pool(io_service& service, uint32_t region_size = 4 * 1024 * 1024, unsigned max_regions = 64)
+        : service(service), region_size(region_size), max_regions(max_regions) {
+        assert(region_size >= min_block && (region_size & (region_size - 1)) == 0 && "region_size must be a power of two");
+        assert(max_regions <= UINT16_MAX + 1u);
+        io_uring_register_buffers_sparse(&service.get_handle(), max_regions) | panic_on_err("io_uring_register_buffers_sparse", false);
+    }
+
+    ~fixed_buffer_pool() noexcept {
+        assert(leased == 0 && "A fixed_buffer outlives its pool");
+        service.unregister_buffers();
+        for (char* region : regions) munmap(region, region_size);
+    }
+
+    fixed_buffer_pool(const fixed_buffer_pool&) = delete;
+    fixed_buffer_pool& operator =(const fixed_buffer_pool&) = delete;
+
+    /** Take a block of at least `size` bytes
+     * @param size up to region_size
+     * @return the lease, empty if the buffer table is full and the pool can't grow
+     */
+    [[nodiscard]]
+    fixed_buffer acquire(uint32_t size) {
+        assert(size <= region_size && "Block larger than a region");
+        const uint8_t cls = size_class(size);
+        auto*& head = free_blocks[cls];
+        if (!head && !carve(cls)) return {};
+
+        auto* block = head;
+        head = block->next;
+        ++leased;
+        return fixed_buffer(this, reinterpret_cast<char *>(block), min_block << cls, block->buf_index, cls);
+    }
+
+    /** Number of blocks handed out */
+    [[nodiscard]]
+    size_t size() const noexcept { return leased; }
+
+    /** Bytes mapped and registered */
+    [[nodiscard]]
+    size_t capacity() const noexcept { return regions.size() * size_t(region_size); }
+
+private:
+    friend class fixed_buffer;
+
+    /** Header of a free block, stored in the block itself */
+    struct free_block {
+        free_block* next;
+        uint16_t buf_index;
+    };
+
+    static uint8_t size_class(uint32_t size) noexcept {
+        if (size <= min_block) return 0;
+        return uint8_t(32 - __builtin_clz(size - 1) - __builtin_ctz(min_block));
+    }
+
+    void push(char* data, uint16_t buf_index, uint8_t cls) noexcept {
+        auto* block = reinterpret_cast<free_block *>(data);
+        block->next = free_blocks[cls];
+        block->buf_index = buf_index;
+        free_blocks[cls] = block;
+    }
+
+    void give_back(char* data, uint16_t buf_index, uint8_t cls) noexcept {
+        push(data, buf_index, cls);
+        --leased;
+    }
+
+    /** Fill the freelist of a class from the current region, adding a region if it runs out */
+    bool carve(uint8_t cls) {
+        const uint32_t block = min_block << cls;
+        const uint32_t slab = std::min(std::max(block, slab_size), region_size);
+        if (regions.empty() || used + slab > region_size) {
+            // What's left of the current region is not worth splitting; leave it
+            if (!grow()) return false;
+        }
+
+        char* base = regions.back() + used;
+        used += slab;
+        for (uint32_t offset = slab; offset > 0; offset -= block) {
+            // Lowest address on top
+            push(base + offset - block, uint16_t(regions.size() - 1), cls);
+        }
+        return true;
+    }
+
+    /** Map a region and register it into the next slot
+     * @see io_uring_register(2) IORING_REGISTER_BUFFERS_UPDATE
+     */
+    bool grow() {
+        if (regions.size() == max_regions) return false;
+
+        void* region = mmap(nullptr, region_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (region == MAP_FAILED) panic("mmap", errno);
+
+        const iovec iov = to_iov(region, region_size);
+        int ret = io_uring_register_buffers_update_tag(&service.get_handle(), unsigned(regions.size()), &iov, nullptr, 1);
+        if (ret < 0) {
+            munmap(region, region_size);
+            panic("io_uring_register_buffers_update_tag", -ret);
+        }
+        regions.push_back(static_cast<char *>(region));
+        used = 0;
+        return true;
+    }
+
+    io_service& service;
+    const uint32_t region_size;
+    const unsigned max_regions;
+    std::vector<char *> regions;
+    /** Bytes of the last region carved into slabs */
+    uint32_t used = 0;
+    /** One freelist per size class, min_block << class */
+    std::array<free_block*, 32> free_blocks {};
+    size_t leased = 0;
+};
+
+inline void fixed_buffer::release() noexcept {
+    if (!pool) return;
+    pool->give_back(std::exchange(buf, nullptr), index, cls);
+    pool = nullptr;
+}
+
+inline sqe_awaitable io_service::read_fixed(
+    int fd,
+    const fixed_buffer& buf,
+    unsigned nbytes,
+    off_t offset,
+    uint8_t iflags
+) noexcept {
+    assert(nbytes <= buf.size());
+    return read_fixed(fd, buf.data(), nbytes, offset, buf.buf_index(), iflags);
+}
+
+inline sqe_awaitable io_service::write_fixed(
+    int fd,
+    const fixed_buffer& buf,
+    unsigned nbytes,
+    off_t offset,
+    uint8_t iflags
+) noexcept {
+    assert(nbytes <= buf.size());
+    return write_fixed(fd, buf.data(), nbytes, offset, buf.buf_index(), iflags);
+}
+
+inline sqe_awaitable io_service::read_fixed(
+    const fixed_fd& fd,
+    const fixed_buffer& buf,
+    unsigned nbytes,
+    off_t offset,
+    uint8_t iflags
+) noexcept {
+    assert(nbytes <= buf.size());
+    return read_fixed(fd, buf.data(), nbytes, offset, buf.buf_index(), iflags);
+}
+
+inline sqe_awaitable io_service::write_fixed(
+    const fixed_fd& fd,
+    const fixed_buffer& buf,
+    unsigned nbytes,
+    off_t offset,
+    uint8_t iflags
+) noexcept {
+    assert(nbytes <= buf.size());
+    return write_fixed(fd, buf.data(), nbytes, offset, buf.buf_index(), iflags);
+}
+
+} // namespace uio
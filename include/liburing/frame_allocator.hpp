@@ -0,0 +1,187 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <array>
+
+namespace uio {
+/**
+ * Source of coroutine frames of uio::task
+ * Derive from it to put frames in a user arena, and install it with set_frame_allocator
+ */
+struct frame_allocator {
+    /** Allocate a frame, aligned to __STDCPP_DEFAULT_NEW_ALIGNMENT__ */
+    virtual void* allocate(size_t size) = 0;
+    /** Free a frame. `size` is the one passed to allocate */
+    virtual void deallocate(void* ptr, size_t size) noexcept = 0;
+
+protected:
+    ~frame_allocator() = default;
+};
+
+/**
+ * Coroutine frame counters of a thread
+ * A frame is counted as allocated by the thread creating it and as freed by the thread
+ * destroying it, so live counters of a thread are exact only if its frames never move to
+ * another thread ( e.g. stealable coroutines of uio::runtime ). They may even be negative
+ */
+struct frame_stats {
+    /** Frames allocated but not freed yet */
+    int64_t live_frames = 0;
+    /** Bytes of frames allocated but not freed yet */
+    int64_t live_bytes = 0;
+    /** Frames allocated in total */
+    uint64_t allocations = 0;
+    /** Allocations served by the freelists of the default pool */
+    uint64_t pool_hits = 0;
+};
+
+namespace detail {
+inline thread_local frame_allocator* current_frame_allocator = nullptr;
+inline thread_local frame_stats current_frame_stats;
+
+/** Default frame allocator: size-class freelists per thread, backed by global operator new */
+class frame_pool final: public frame_allocator {
+public:
+    static constexpr size_t granularity = 64;
+    static constexpr size_t max_pooled_size = 2048;
+    /** Frames kept per size class, the rest goes back to operator delete */
+    static constexpr unsigned max_cached = 256;
+
+    frame_pool() = default;
+    frame_pool(const frame_pool&) = delete;
+    frame_pool& operator =(const frame_pool&) = delete;
+
+    ~frame_pool() noexcept {
+        for (auto& list : lists) {
+            while (list.head) ::operator delete(pop(list));
+        }
+        destroyed = true;
+    }
+
+    void* allocate(size_t size) override {
+        if (size > max_pooled_size) return ::operator new(size);
+        auto& list = lists[index(size)];
+        if (list.head) {
+            ++current_frame_stats.pool_hits;
+            return pop(list);
+        }
+        return ::operator new(block_size(size));
+    }
+
+    void deallocate(void* ptr, size_t size) noexcept override {
+        if (size > max_pooled_size) return ::operator delete(ptr);
+        auto& list = lists[index(size)];
+        if (list.count >= max_cached) return ::operator delete(ptr);
+        list.head = new (ptr) node { list.head };
+        ++list.count;
+    }
+
+    /** The pool of the calling thread, or nullptr once it's destroyed at thread exit */
+    static frame_pool* instance() noexcept {
+        if (destroyed) return nullptr;
+        thread_local frame_pool pool;
+        return &pool;
+    }
+
+    /** Allocate from the pool of the calling thread, or from operator new once it's gone */
+    static void* allocate_local(size_t size) {
+        if (auto* pool = instance()) return pool->allocate(size);
+        return ::operator new(block_size(size));
+    }
+
+    /** Free into the pool of the calling thread, or to operator delete once it's gone
+     * Blocks may be freed on another thread than the one allocating them,
+     * e.g. by thread_local destructors or frames finished at thread exit
+     */
+    static void deallocate_local(void* ptr, size_t size) noexcept {
+        if (auto* pool = instance()) return pool->deallocate(ptr, size);
+        ::operator delete(ptr);
+    }
+
+private:
+    struct node {
+        node* next;
+    };
+
+    struct freelist {
+        node* head = nullptr;
+        unsigned count = 0;
+    };
+
+    static constexpr size_t index(size_t size) noexcept {
+        return (size - 1) / granularity;
+    }
+
+    /** Pooled blocks are rounded up to their size class, so that any pool can recycle them */
+    static constexpr size_t block_size(size_t size) noexcept {
+        return size > max_pooled_size ? size : (index(size) + 1) * granularity;
+    }
+
+    static void* pop(freelist& list) noexcept {
+        auto* result = list.head;
+        list.head = result->next;
+        --list.count;
+        return result;
+    }
+
+    std::array<freelist, max_pooled_size / granularity> lists;
+    /** Trivially destructible, so it's still readable after the pool is gone */
+    static inline thread_local bool destroyed = false;
+};
+
+/** Placed before each frame to find its allocator when it's freed */
+struct alignas(__STDCPP_DEFAULT_NEW_ALIGNMENT__) frame_header {
+    /** nullptr means the default pool of the thread freeing the frame */
+    frame_allocator* allocator;
+};
+
+inline void* allocate_frame(size_t size) {
+    size += sizeof (frame_header);
+    auto* allocator = current_frame_allocator;
+    void* ptr = allocator ? allocator->allocate(size) : frame_pool::allocate_local(size);
+
+    auto& stats = current_frame_stats;
+    ++stats.live_frames;
+    stats.live_bytes += int64_t(size);
+    ++stats.allocations;
+    return new (ptr) frame_header { allocator } + 1;
+}
+
+inline void deallocate_frame(void* ptr, size_t size) noexcept {
+    auto* header = static_cast<frame_header *>(ptr) - 1;
+    size += sizeof (frame_header);
+
+    auto& stats = current_frame_stats;
+    --stats.live_frames;
+    stats.live_bytes -= int64_t(size);
+    if (header->allocator) {
+        header->allocator->deallocate(header, size);
+    } else {
+        frame_pool::deallocate_local(header, size);
+    }
+}
+} // namespace detail
+
+/** Install an allocator for coroutine frames created by the current thread
+ * @param allocator allocator to use, or nullptr for the default pool
+ * @return the allocator installed before
+ * @note frames are given back to the allocator they came from, even when
+ *       destroyed on another thread. The allocator must outlive its frames
+ */
+inline frame_allocator* set_frame_allocator(frame_allocator* allocator) noexcept {
+    auto* prev = detail::current_frame_allocator;
+    detail::current_frame_allocator = allocator;
+    return prev;
+}
+
+/** Get coroutine frame counters of the current thread
+ * @note see frame_stats for frames moving between threads
+ */
+[[nodiscard]]
+inline frame_stats get_frame_stats() noexcept {
+    return detail::current_frame_stats;
+}
+
+} // namespace uio
@@ -1,12 +1,18 @@
 #pragma once
+#include <algorithm>
+#include <atomic>
 #include <functional>
 #include <system_error>
 #include <chrono>
+#include <cstring>
+#include <memory>
 #include <sys/poll.h>
 #include <sys/timerfd.h>
 #include <sys/stat.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <sched.h>
+#include <linux/futex.h>
 #include <liburing.h>   // http://git.kernel.dk/liburing
 #ifndef NDEBUG
 #   include <execinfo.h>
@@ -16,6 +22,14 @@
 #include <liburing/task.hpp>
 #include <liburing/utils.hpp>
 
+// futex2 flags, missing from older uapi headers
+#ifndef FUTEX2_SIZE_U32
+#   define FUTEX2_SIZE_U32 0x02
+#endif
+#ifndef FUTEX2_PRIVATE
+#   define FUTEX2_PRIVATE FUTEX_PRIVATE_FLAG
+#endif
+
 #ifdef LIBURING_VERBOSE
 #   define puts_if_verbose(x) puts(x)
 #   define printf_if_verbose(...) printf(__VA_ARGS__)
@@ -25,6 +39,157 @@
 #endif
 
 namespace uio {
+class buffer_ring;
+struct buffer_awaitable;
+class multishot_stream;
+class buffer_stream;
+class zc_send;
+struct buffer_lease;
+struct sleep_awaitable;
+struct sq_space_awaitable;
+class fixed_fd;
+class fixed_buffer;
+template <typename T> class channel;
+
+namespace detail {
+struct timer_driver;
+// Defined along with timer_driver
+inline void destroy(timer_driver* driver) noexcept;
+
+/** A coroutine parked on a synchronization primitive, or ready to be resumed by the run loop */
+struct parked {
+    std::coroutine_handle<> handle;
+    parked* next = nullptr;
+};
+
+/** Intrusive FIFO of parked coroutines */
+struct parked_list {
+    void push_back(parked& node) noexcept {
+        node.next = nullptr;
+        if (tail) {
+            tail->next = &node;
+        } else {
+            head = &node;
+        }
+        tail = &node;
+    }
+
+    parked* pop_front() noexcept {
+        auto* node = head;
+        head = node->next;
+        if (!head) tail = nullptr;
+        return node;
+    }
+
+    bool empty() const noexcept {
+        return !head;
+    }
+
+    parked* head = nullptr;
+    parked* tail = nullptr;
+};
+
+/** Ring of a thread without an io_service, used to post cqes to other rings only
+ * @see io_uring_enter(2) IORING_OP_MSG_RING
+ */
+struct messenger {
+    messenger() {
+        io_uring_queue_init(4, &ring, 0) | panic_on_err("queue_init", false);
+    }
+    ~messenger() noexcept {
+        io_uring_queue_exit(&ring);
+    }
+
+    messenger(const messenger&) = delete;
+    messenger& operator =(const messenger&) = delete;
+
+    /** The messenger of the calling thread, created on first use */
+    static messenger& local() {
+        thread_local messenger instance;
+        return instance;
+    }
+
+    /** Post a cqe carrying `data` as user_data to the ring of `fd`, synchronously */
+    void post(int fd, uint64_t data) {
+        auto* sqe = io_uring_get_sqe(&ring);
+        io_uring_prep_msg_ring(sqe, fd, 0, data, 0);
+        io_uring_submit_and_wait(&ring, 1) | panic_on_err("io_uring_submit_and_wait", false);
+
+        io_uring_cqe* cqe;
+        io_uring_peek_cqe(&ring, &cqe);
+        int res = cqe->res;
+        io_uring_cqe_seen(&ring, cqe);
+        res | panic_on_err("msg_ring", false);
+    }
+
+    io_uring ring;
+};
+
+/** A function posted to an io_service from another thread, linked into its inbox */
+struct posted {
+    virtual ~posted() = default;
+    virtual void run() noexcept = 0;
+
+    posted* next = nullptr;
+};
+
+template <typename Fn>
+struct posted_fn final: posted {
+    explicit posted_fn(Fn&& fn): fn(std::forward<Fn>(fn)) {}
+
+    void run() noexcept override {
+        fn();
+    }
+
+    std::decay_t<Fn> fn;
+};
+} // namespace detail
+
+/** Configuration of a kernel thread polling the SQ
+ * @see io_uring_setup(2) IORING_SETUP_SQPOLL
+ */
+struct sqpoll_options {
+    /** Milliseconds the poller thread keeps spinning without work before it
+     * goes to sleep and has to be waken up by io_uring_enter */
+    unsigned idle_ms = 1000;
+    /** CPU the poller thread is pinned to ( IORING_SETUP_SQ_AFF ), or -1 */
+    int cpu = -1;
+    /** Microseconds `run()` busy-polls the CQ before blocking in io_uring_enter.
+     * With the poller thread awake, a non-zero value makes the hot path free
+     * of syscalls, at the cost of burning the calling thread too */
+    unsigned spin_us = 0;
+};
+
+/** Setup flags for a ring only ever used by the thread creating it, which is
+ * how io_service is meant to be used. Ones the kernel doesn't support are dropped
+ * @see io_uring_setup(2)
+ */
+struct setup_options {
+    /** Only the creating thread submits ( IORING_SETUP_SINGLE_ISSUER, 6.0 ) */
+    bool single_issuer = true;
+    /** Size of the CQ ( IORING_SETUP_CQSIZE ), 0 for twice the SQ. Make it as
+     * large as the number of operations expected in flight, so that bursts
+     * of completions don't overflow it */
+    unsigned cq_entries = 0;
+    /** Completion work runs when `run()` waits for cqes, not when the kernel
+     * interrupts the thread ( IORING_SETUP_DEFER_TASKRUN, 6.1 ). Needs single_issuer */
+    bool defer_taskrun = true;
+    /** The kernel doesn't interrupt the thread to run completion work, it's run
+     * on the next io_uring_enter instead ( IORING_SETUP_COOP_TASKRUN, 5.19 ) */
+    bool coop_taskrun = true;
+
+    /** io_uring_setup flags of the options */
+    [[nodiscard]]
+    uint32_t flags() const noexcept {
+        uint32_t flags = 0;
+        if (coop_taskrun) flags |= IORING_SETUP_COOP_TASKRUN | IORING_SETUP_TASKRUN_FLAG;
+        if (single_issuer) flags |= IORING_SETUP_SINGLE_ISSUER;
+        if (single_issuer && defer_taskrun) flags |= IORING_SETUP_DEFER_TASKRUN;
+        if (cq_entries) flags |= IORING_SETUP_CQSIZE;
+        return flags;
+    }
+};
+
 class io_service {
 public:
     /** Init io_service / io_uring object
@@ -38,13 +203,79 @@ public:
      *       flag to make sure that kernel shares the only async worker thread pool.
      *       See `IORING_SETUP_ATTACH_WQ` for detail.
      */
-    io_service(int entries = 64, uint32_t flags = 0, uint32_t wq_fd = 0) {
-        io_uring_params p = {
+    io_service(int entries = 64, uint32_t flags = 0, uint32_t wq_fd = 0)
+        : io_service(entries, io_uring_params {
             .flags = flags,
             .wq_fd = wq_fd,
+        }) {}
+
+    /** Init io_service / io_uring object with a kernel thread polling the SQ
+     * @see io_uring_setup(2) IORING_SETUP_SQPOLL
+     * @param entries Maximum sqe can be gotten without submitting
+     * @param sqpoll configuration of the poller thread
+     * @param flags other flags used to init io_uring
+     * @param wq_fd existing io_uring ring_fd used by IORING_SETUP_ATTACH_WQ
+     * @note `run()` only enters the kernel to wake the poller thread up, or to
+     *       wait for cqes once `sqpoll.spin_us` runs out
+     */
+    io_service(int entries, const sqpoll_options& sqpoll, uint32_t flags = 0, uint32_t wq_fd = 0)
+        : io_service(entries, io_uring_params {
+            .flags = flags | IORING_SETUP_SQPOLL | (sqpoll.cpu >= 0 ? IORING_SETUP_SQ_AFF : 0),
+            .sq_thread_cpu = sqpoll.cpu >= 0 ? uint32_t(sqpoll.cpu) : 0,
+            .sq_thread_idle = sqpoll.idle_ms,
+            .wq_fd = wq_fd,
+        }) {
+        spin_time = std::chrono::microseconds(sqpoll.spin_us);
+    }
+
+    /** Init io_service / io_uring object for use by the calling thread only
+     * @see io_uring_setup(2) IORING_SETUP_SINGLE_ISSUER IORING_SETUP_DEFER_TASKRUN
+     * @param entries Maximum sqe can be gotten without submitting
+     * @param options setup flags to try, see setup_flags() for the ones in effect
+     * @param flags other flags used to init io_uring
+     * @param wq_fd existing io_uring ring_fd used by IORING_SETUP_ATTACH_WQ
+     * @warning with single_issuer, submitting from any other thread fails with -EEXIST
+     */
+    io_service(int entries, const setup_options& options, uint32_t flags = 0, uint32_t wq_fd = 0)
+        : io_service(entries, io_uring_params {
+            .cq_entries = options.cq_entries,
+            .flags = flags | options.flags(),
+            .wq_fd = wq_fd,
+        }, options.flags() & ~IORING_SETUP_CQSIZE) {}
+
+    /** Init io_service / io_uring object with raw parameters
+     * @see io_uring_setup(2)
+     * @param entries Maximum sqe can be gotten without submitting
+     * @param p parameters passed to io_uring_setup
+     */
+    io_service(int entries, io_uring_params p): io_service(entries, p, 0) {}
+
+private:
+    /** @param optional setup flags dropped, newest first, while the kernel rejects them */
+    io_service(int entries, io_uring_params p, uint32_t optional) {
+        static constexpr uint32_t newest_first[] = {
+            IORING_SETUP_DEFER_TASKRUN,
+            IORING_SETUP_SINGLE_ISSUER,
+            IORING_SETUP_COOP_TASKRUN | IORING_SETUP_TASKRUN_FLAG,
         };
+        for (const uint32_t* next = newest_first; ; ) {
+            auto params = p;
+            int ret = io_uring_queue_init_params(entries, &ring, &params);
+            if (ret == -EINVAL && (p.flags & optional)) {
+                while (!(p.flags & optional & *next)) ++next;
+                printf_if_verbose(__FILE__ ": setup flags %#x are not supported, retrying without them\n", *next);
+                p.flags &= ~*next;
+                continue;
+            }
+            ret | panic_on_err("queue_init_params", false);
+            p = params;
+            break;
+        }
 
-        io_uring_queue_init_params(entries, &ring, &p) | panic_on_err("queue_init_params", false);
+        // io_uring_enter skips looking the ring fd up ( 5.18 ); without it, the ring fd is used as is
+        if (int ret = io_uring_register_ring_fd(&ring); ret < 0) {
+            printf_if_verbose(__FILE__ ": io_uring_register_ring_fd: %s\n", strerror(-ret));
+        }
 
         auto* probe = io_uring_get_probe_ring(&ring);
         on_scope_exit free_probe([=]() { io_uring_free_probe(probe); });
@@ -107,6 +338,9 @@ public:
     TEST_IORING_OP(IORING_OP_URING_CMD);
     TEST_IORING_OP(IORING_OP_SEND_ZC);
     TEST_IORING_OP(IORING_OP_SENDMSG_ZC);
+    TEST_IORING_OP(IORING_OP_FUTEX_WAIT);
+    TEST_IORING_OP(IORING_OP_FUTEX_WAKE);
+    TEST_IORING_OP(IORING_OP_FUTEX_WAITV);
 #undef TEST_IORING_OP
 
 #define TEST_IORING_FEATURE(feature) if (p.features & feature) puts_if_verbose("\t" #feature)
@@ -128,9 +362,18 @@ public:
 #undef TEST_IORING_FEATURE
     }
 
+public:
+
     /** Destroy io_service / io_uring object */
     ~io_service() noexcept {
         io_uring_queue_exit(&ring);
+        // Functions posted too late are dropped
+        for (auto* item = inbox.load(std::memory_order_acquire); item; ) {
+            delete std::exchange(item, item->next);
+        }
+        for (auto* driver : timer_drivers) {
+            if (driver) detail::destroy(driver);
+        }
     }
 
     // io_service is not copyable. It can be moveable but humm...
@@ -219,6 +462,20 @@ public:
         return await_work(sqe, iflags);
     }
 
+    /** Read from a file descriptor into a buffer picked from a provided buffer ring
+     * @see pread(2)
+     * @see io_uring_enter(2) IORING_OP_READ IOSQE_BUFFER_SELECT
+     * @param buffers buffer ring the kernel picks the buffer from
+     * @param iflags IOSQE_* flags
+     * @return a task object for awaiting, resolved to a buffer_lease
+     */
+    buffer_awaitable read(
+        int fd,
+        buffer_ring& buffers,
+        off_t offset,
+        uint8_t iflags = 0
+    ) noexcept;
+
     /** Write to a file descriptor at a given offset asynchronously
      * @see pwrite(2)
      * @see io_uring_enter(2) IORING_OP_WRITE
@@ -365,6 +622,35 @@ public:
         return await_work(sqe, iflags);
     }
 
+    /** Receive a message from a socket into a buffer picked from a provided buffer ring
+     * @see recv(2)
+     * @see io_uring_enter(2) IORING_OP_RECV IOSQE_BUFFER_SELECT
+     * @param buffers buffer ring the kernel picks the buffer from
+     * @param iflags IOSQE_* flags
+     * @return a task object for awaiting, resolved to a buffer_lease
+     */
+    buffer_awaitable recv(
+        int sockfd,
+        buffer_ring& buffers,
+        uint32_t flags,
+        uint8_t iflags = 0
+    ) noexcept;
+
+    /** Receive messages from a socket continuously with one sqe, into buffers
+     * picked from a provided buffer ring
+     * @see recv(2)
+     * @see io_uring_enter(2) IORING_OP_RECV IORING_RECV_MULTISHOT IOSQE_BUFFER_SELECT
+     * @param buffers buffer ring the kernel picks buffers from
+     * @param iflags IOSQE_* flags
+     * @return a stream yielding a buffer_lease per message
+     */
+    buffer_stream multishot_recv(
+        int sockfd,
+        buffer_ring& buffers,
+        uint32_t flags = 0,
+        uint8_t iflags = 0
+    );
+
     /** Send a message on a socket asynchronously
      * @see send(2)
      * @see io_uring_enter(2) IORING_OP_SEND
@@ -383,6 +669,49 @@ public:
         return await_work(sqe, iflags);
     }
 
+    /** Send a message on a socket without copying the buffer into the kernel
+     * @see send(2)
+     * @see io_uring_enter(2) IORING_OP_SEND_ZC
+     * @param buf must stay untouched until `co_await op.notified()` resumes
+     * @param iflags IOSQE_* flags
+     * @return a zc_send object for awaiting the result and the notification
+     */
+    zc_send send_zc(
+        int sockfd,
+        const void* buf,
+        unsigned nbytes,
+        uint32_t flags,
+        uint8_t iflags = 0
+    );
+
+    /** Send a buffer picked from a buffer ring without copying it into the kernel
+     * @see send(2)
+     * @see io_uring_enter(2) IORING_OP_SEND_ZC
+     * @param lease sends lease.size() bytes; given back to its ring on notification
+     * @param iflags IOSQE_* flags
+     * @return a zc_send object for awaiting the result and the notification
+     */
+    zc_send send_zc(
+        int sockfd,
+        buffer_lease&& lease,
+        uint32_t flags,
+        uint8_t iflags = 0
+    );
+
+    /** Send a message on a socket without copying the buffers into the kernel
+     * @see sendmsg(2)
+     * @see io_uring_enter(2) IORING_OP_SENDMSG_ZC
+     * @param msg buffers must stay untouched until `co_await op.notified()` resumes
+     * @param iflags IOSQE_* flags
+     * @return a zc_send object for awaiting the result and the notification
+     */
+    zc_send sendmsg_zc(
+        int sockfd,
+        const msghdr* msg,
+        uint32_t flags,
+        uint8_t iflags = 0
+    );
+
     /** Wait for an event on a file descriptor asynchronously
      * @see poll(2)
      * @see io_uring_enter(2)
@@ -430,6 +759,52 @@ public:
         return await_work(sqe, iflags);
     }
 
+    /** Accept a connection on a socket into the registered file table asynchronously
+     * @see accept4(2)
+     * @see io_uring_enter(2) IORING_OP_ACCEPT IORING_FILE_INDEX_ALLOC
+     * @param file_index slot to install the socket into, or IORING_FILE_INDEX_ALLOC to pick a free one
+     * @param iflags IOSQE_* flags
+     * @return a task object for awaiting, resolved to the allocated slot when
+     *         IORING_FILE_INDEX_ALLOC is used
+     */
+    sqe_awaitable accept_direct(
+        int fd,
+        sockaddr *addr,
+        socklen_t *addrlen,
+        int flags = 0,
+        unsigned file_index = IORING_FILE_INDEX_ALLOC,
+        uint8_t iflags = 0
+    ) noexcept {
+        auto* sqe = io_uring_get_sqe_safe();
+        io_uring_prep_accept_direct(sqe, fd, addr, addrlen, flags, file_index);
+        return await_work(sqe, iflags);
+    }
+
+    /** Accept connections on a socket continuously with one sqe
+     * @see accept4(2)
+     * @see io_uring_enter(2) IORING_OP_ACCEPT IORING_ACCEPT_MULTISHOT
+     * @param iflags IOSQE_* flags
+     * @return a stream yielding accepted fds ( or -errno ). It's rearmed
+     *         automatically when the kernel ends the multishot request
+     */
+    multishot_stream multishot_accept(
+        int fd,
+        int flags = 0,
+        uint8_t iflags = 0
+    );
+
+    /** Accept connections on a socket continuously into free slots of the registered file table
+     * @see accept4(2)
+     * @see io_uring_enter(2) IORING_OP_ACCEPT IORING_ACCEPT_MULTISHOT IORING_FILE_INDEX_ALLOC
+     * @param iflags IOSQE_* flags
+     * @return a stream yielding allocated slots ( or -errno )
+     */
+    multishot_stream multishot_accept_direct(
+        int fd,
+        int flags = 0,
+        uint8_t iflags = 0
+    );
+
     /** Initiate a connection on a socket asynchronously
      * @see connect(2)
      * @see io_uring_enter(2) IORING_OP_CONNECT
@@ -463,6 +838,24 @@ public:
         return await_work(sqe, iflags);
     }
 
+    /** Sleep for specified duration on the timer wheel of a clock
+     * All sleeps and uio::timer objects of a clock share a single kernel timeout,
+     * armed for the earliest of them. Resolution is 1ms; a sleep never ends early
+     * @param clock CLOCK_MONOTONIC, CLOCK_BOOTTIME or CLOCK_REALTIME
+     * @return an awaitable resumed when the duration has passed
+     */
+    sleep_awaitable sleep_for(
+        std::chrono::nanoseconds duration,
+        clockid_t clock = CLOCK_MONOTONIC
+    );
+
+    /** Sleep until an absolute deadline on the timer wheel of its clock
+     * @see sleep_for
+     * @return an awaitable resumed when the deadline has passed
+     */
+    sleep_awaitable sleep_until(std::chrono::steady_clock::time_point deadline);
+    sleep_awaitable sleep_until(std::chrono::system_clock::time_point deadline);
+
     /** Open and possibly create a file asynchronously
      * @see openat(2)
      * @see io_uring_enter(2) IORING_OP_OPENAT
@@ -481,6 +874,47 @@ public:
         return await_work(sqe, iflags);
     }
 
+    /** Open and possibly create a file into the registered file table asynchronously
+     * @see openat(2)
+     * @see io_uring_enter(2) IORING_OP_OPENAT IORING_FILE_INDEX_ALLOC
+     * @param file_index slot to install the file into, or IORING_FILE_INDEX_ALLOC to pick a free one
+     * @param iflags IOSQE_* flags
+     * @return a task object for awaiting, resolved to the allocated slot when
+     *         IORING_FILE_INDEX_ALLOC is used
+     */
+    sqe_awaitable openat_direct(
+        int dfd,
+        const char *path,
+        int flags,
+        mode_t mode,
+        unsigned file_index = IORING_FILE_INDEX_ALLOC,
+        uint8_t iflags = 0
+    ) noexcept {
+        auto* sqe = io_uring_get_sqe_safe();
+        io_uring_prep_openat_direct(sqe, dfd, path, flags, mode, file_index);
+        return await_work(sqe, iflags);
+    }
+
+    /** Create a socket into the registered file table asynchronously
+     * @see socket(2)
+     * @see io_uring_enter(2) IORING_OP_SOCKET IORING_FILE_INDEX_ALLOC
+     * @param file_index slot to install the socket into, or IORING_FILE_INDEX_ALLOC to pick a free one
+     * @param iflags IOSQE_* flags
+     * @return a task object for awaiting, resolved to the allocated slot when
+     *         IORING_FILE_INDEX_ALLOC is used
+     */
+    sqe_awaitable socket_direct(
+        int domain,
+        int type,
+        int protocol,
+        unsigned file_index = IORING_FILE_INDEX_ALLOC,
+        uint8_t iflags = 0
+    ) noexcept {
+        auto* sqe = io_uring_get_sqe_safe();
+        io_uring_prep_socket_direct(sqe, domain, type, protocol, file_index, 0);
+        return await_work(sqe, iflags);
+    }
+
     /** Close a file descriptor asynchronously
      * @see close(2)
      * @see io_uring_enter(2) IORING_OP_CLOSE
@@ -496,6 +930,20 @@ public:
         return await_work(sqe, iflags);
     }
 
+    /** Close a slot of the registered file table asynchronously
+     * @see io_uring_enter(2) IORING_OP_CLOSE
+     * @param iflags IOSQE_* flags
+     * @return a task object for awaiting
+     */
+    sqe_awaitable close_direct(
+        unsigned file_index,
+        uint8_t iflags = 0
+    ) noexcept {
+        auto* sqe = io_uring_get_sqe_safe();
+        io_uring_prep_close_direct(sqe, file_index);
+        return await_work(sqe, iflags);
+    }
+
     /** Get file status asynchronously
      * @see statx(2)
      * @see io_uring_enter(2) IORING_OP_STATX
@@ -658,7 +1106,42 @@ public:
         return await_work(sqe, iflags);
     }
 
-    /** Delete a name and possibly the file it refers to asynchronously
+    /** Cancel pending requests matching user_data asynchronously
+     * @see io_uring_enter(2) IORING_OP_ASYNC_CANCEL
+     * @param user_data user_data of the request, see to_user_data
+     * @param flags IORING_ASYNC_CANCEL_* flags, e.g. IORING_ASYNC_CANCEL_ALL or IORING_ASYNC_CANCEL_ANY
+     * @param iflags IOSQE_* flags
+     * @return a task object for awaiting, resolved to 0 ( or the number of requests
+     *         canceled with IORING_ASYNC_CANCEL_ALL ), -ENOENT if none is found
+     */
+    sqe_awaitable cancel(
+        uint64_t user_data,
+        int flags = 0,
+        uint8_t iflags = 0
+    ) noexcept {
+        auto* sqe = io_uring_get_sqe_safe();
+        io_uring_prep_cancel64(sqe, user_data, flags);
+        return await_work(sqe, iflags);
+    }
+
+    /** Cancel pending requests on a file descriptor asynchronously
+     * @see io_uring_enter(2) IORING_OP_ASYNC_CANCEL IORING_ASYNC_CANCEL_FD
+     * @param flags IORING_ASYNC_CANCEL_* flags, IORING_ASYNC_CANCEL_ALL to cancel
+     *        all of them, IORING_ASYNC_CANCEL_FD_FIXED if `fd` is a registered file
+     * @param iflags IOSQE_* flags
+     * @return a task object for awaiting
+     */
+    sqe_awaitable cancel_fd(
+        int fd,
+        unsigned flags = 0,
+        uint8_t iflags = 0
+    ) noexcept {
+        auto* sqe = io_uring_get_sqe_safe();
+        io_uring_prep_cancel_fd(sqe, fd, flags);
+        return await_work(sqe, iflags);
+    }
+
+    /** Post a cqe to another ring asynchronously
      * @see io_uring_enter(2) IORING_OP_MSG_RING
      * @param iflags IOSQE_* flags
      * @return a task object for awaiting
@@ -675,34 +1158,159 @@ public:
         return await_work(sqe, iflags);
     }
 
+    /** Move a registered file into the registered file table of another ring asynchronously
+     * @see io_uring_enter(2) IORING_OP_MSG_RING IORING_MSG_SEND_FD
+     * @param target_fd ring fd of the ring receiving the file
+     * @param file_index slot of the file in the table of this ring. It's left
+     *        untouched; close it with close_direct once the file is sent
+     * @param target_index slot to install the file into, or IORING_FILE_INDEX_ALLOC to pick a free one
+     * @param data user_data of the cqe posted to the target ring, whose result is the
+     *        slot installed into. No cqe is posted if it's 0
+     * @param iflags IOSQE_* flags
+     * @return a task object for awaiting
+     */
+    sqe_awaitable send_fd(
+        int target_fd,
+        unsigned file_index,
+        unsigned target_index = IORING_FILE_INDEX_ALLOC,
+        uint64_t data = 0,
+        uint8_t iflags = 0
+    ) noexcept {
+        auto* sqe = io_uring_get_sqe_safe();
+        io_uring_prep_msg_ring_fd(sqe, target_fd, int(file_index), int(target_index), data,
+            data ? 0 : IORING_MSG_RING_CQE_SKIP);
+        return await_work(sqe, iflags);
+    }
+
+    /** @see send_fd above
+     * @param target ring receiving the file, only its ring fd is read
+     * @warning `target` must stay alive until the send completes; across threads, keep its
+     *          ring fd and use the overload above
+     */
+    sqe_awaitable send_fd(
+        io_service& target,
+        unsigned file_index,
+        unsigned target_index = IORING_FILE_INDEX_ALLOC,
+        uint64_t data = 0,
+        uint8_t iflags = 0
+    ) noexcept {
+        return send_fd(target.ring.ring_fd, file_index, target_index, data, iflags);
+    }
+
+    /** Wait on a futex asynchronously, if it still holds `val`
+     * @see futex(2) FUTEX_WAIT_BITSET
+     * @see io_uring_enter(2) IORING_OP_FUTEX_WAIT
+     * @param futex_flags FUTEX2_* flags; FUTEX2_PRIVATE only pairs with wakers of the same process
+     * @param iflags IOSQE_* flags
+     * @return a task object for awaiting, resolved to 0 once woken up, or -EAGAIN if `*futex != val`
+     */
+    sqe_awaitable futex_wait(
+        uint32_t* futex,
+        uint64_t val,
+        uint64_t mask = FUTEX_BITSET_MATCH_ANY,
+        uint32_t futex_flags = FUTEX2_SIZE_U32 | FUTEX2_PRIVATE,
+        uint8_t iflags = 0
+    ) noexcept {
+        auto* sqe = io_uring_get_sqe_safe();
+        io_uring_prep_futex_wait(sqe, futex, val, mask, futex_flags, 0);
+        return await_work(sqe, iflags);
+    }
+
+    /** Wake up waiters of a futex asynchronously
+     * @see futex(2) FUTEX_WAKE_BITSET
+     * @see io_uring_enter(2) IORING_OP_FUTEX_WAKE
+     * @param nr maximum number of waiters to wake up
+     * @param futex_flags FUTEX2_* flags, as passed to futex_wait
+     * @param iflags IOSQE_* flags
+     * @return a task object for awaiting, resolved to the number of waiters woken up
+     */
+    sqe_awaitable futex_wake(
+        uint32_t* futex,
+        uint64_t nr,
+        uint64_t mask = FUTEX_BITSET_MATCH_ANY,
+        uint32_t futex_flags = FUTEX2_SIZE_U32 | FUTEX2_PRIVATE,
+        uint8_t iflags = 0
+    ) noexcept {
+        auto* sqe = io_uring_get_sqe_safe();
+        io_uring_prep_futex_wake(sqe, futex, nr, mask, futex_flags, 0);
+        return await_work(sqe, iflags);
+    }
+
+    /** Wait on any of several futexes asynchronously
+     * @see futex_waitv(2)
+     * @see io_uring_enter(2) IORING_OP_FUTEX_WAITV
+     * @param futexes up to FUTEX_WAITV_MAX, must live until the operation completes
+     * @param iflags IOSQE_* flags
+     * @return a task object for awaiting, resolved to the index of the futex woken up
+     */
+    sqe_awaitable futex_waitv(
+        futex_waitv* futexes,
+        uint32_t nr_futex,
+        uint8_t iflags = 0
+    ) noexcept {
+        auto* sqe = io_uring_get_sqe_safe();
+        io_uring_prep_futex_waitv(sqe, futexes, nr_futex, 0);
+        return await_work(sqe, iflags);
+    }
+
 private:
     sqe_awaitable await_work(
         io_uring_sqe* sqe,
         uint8_t iflags
     ) noexcept {
         io_uring_sqe_set_flags(sqe, iflags);
-        return sqe_awaitable(sqe);
+        return sqe_awaitable(sqe, this);
     }
 
 public:
+    /** @{ */
+    /** Operations on a slot of a file_table. IOSQE_FIXED_FILE is set, the kernel
+     * skips looking the file up and counting its references
+     * @see file_table.hpp
+     */
+    sqe_awaitable readv(const fixed_fd& fd, const iovec* iovecs, unsigned nr_vecs, off_t offset, uint8_t iflags = 0) noexcept;
+    sqe_awaitable writev(const fixed_fd& fd, const iovec* iovecs, unsigned nr_vecs, off_t offset, uint8_t iflags = 0) noexcept;
+    sqe_awaitable read(const fixed_fd& fd, void* buf, unsigned nbytes, off_t offset, uint8_t iflags = 0) noexcept;
+    sqe_awaitable write(const fixed_fd& fd, const void* buf, unsigned nbytes, off_t offset, uint8_t iflags = 0) noexcept;
+    sqe_awaitable read_fixed(const fixed_fd& fd, void* buf, unsigned nbytes, off_t offset, int buf_index, uint8_t iflags = 0) noexcept;
+    sqe_awaitable write_fixed(const fixed_fd& fd, const void* buf, unsigned nbytes, off_t offset, int buf_index, uint8_t iflags = 0) noexcept;
+    sqe_awaitable fsync(const fixed_fd& fd, unsigned fsync_flags, uint8_t iflags = 0) noexcept;
+    sqe_awaitable recv(const fixed_fd& fd, void* buf, unsigned nbytes, uint32_t flags, uint8_t iflags = 0) noexcept;
+    sqe_awaitable send(const fixed_fd& fd, const void* buf, unsigned nbytes, uint32_t flags, uint8_t iflags = 0) noexcept;
+    sqe_awaitable connect(const fixed_fd& fd, sockaddr *addr, socklen_t addrlen, int flags = 0, uint8_t iflags = 0) noexcept;
+    sqe_awaitable shutdown(const fixed_fd& fd, int how, uint8_t iflags = 0) noexcept;
+    /** @} */
+
+    /** @{ */
+    /** read_fixed / write_fixed on a block of a fixed_buffer_pool, `nbytes` up to its size
+     * @see fixed_buffer_pool.hpp
+     */
+    sqe_awaitable read_fixed(int fd, const fixed_buffer& buf, unsigned nbytes, off_t offset, uint8_t iflags = 0) noexcept;
+    sqe_awaitable write_fixed(int fd, const fixed_buffer& buf, unsigned nbytes, off_t offset, uint8_t iflags = 0) noexcept;
+    sqe_awaitable read_fixed(const fixed_fd& fd, const fixed_buffer& buf, unsigned nbytes, off_t offset, uint8_t iflags = 0) noexcept;
+    sqe_awaitable write_fixed(const fixed_fd& fd, const fixed_buffer& buf, unsigned nbytes, off_t offset, uint8_t iflags = 0) noexcept;
+    /** @} */
+
     /** Get a sqe pointer that can never be NULL
-     * @param ring pointer to inited io_uring struct
+     * A full SQ is submitted to make room. Under SQPOLL, it waits for the SQ thread to take them
      * @return pointer to `io_uring_sqe` struct (not NULL)
+     * @note panics if the kernel doesn't take the sqes, which happens while the CQ overflows
+     *       ( -EBUSY ). Producers of bursts should `co_await reserve_sqes()` first
      */
     [[nodiscard]]
     io_uring_sqe* io_uring_get_sqe_safe() noexcept {
         auto* sqe = io_uring_get_sqe(&ring);
-        if (__builtin_expect(!!sqe, true)) {
-            return sqe;
-        } else {
-            printf_if_verbose(__FILE__ ": SQ is full, flushing %u cqe(s)\n", cqe_count);
-            io_uring_cq_advance(&ring, cqe_count);
-            cqe_count = 0;
-            io_uring_submit(&ring);
+        if (__builtin_expect(!sqe, false)) {
+            puts_if_verbose(__FILE__ ": SQ is full, submitting");
+            submit();
+            wait_sq_space(1);
             sqe = io_uring_get_sqe(&ring);
-            if (__builtin_expect(!!sqe, true)) return sqe;
-            panic("io_uring_get_sqe", ENOMEM);
+            if (__builtin_expect(!sqe, false)) panic("io_uring_get_sqe", EBUSY);
         }
+        // io_uring_prep_* don't touch user_data. Clear what the previous user of
+        // the slot left, so that sqes not awaited don't resolve a stale resolver
+        io_uring_sqe_set_data(sqe, nullptr);
+        return sqe;
     }
 
     /** Wait for an event forever, blocking
@@ -712,27 +1320,89 @@ public:
      */
     template <typename T, bool nothrow>
     T run(const task<T, nothrow>& t) noexcept(nothrow) {
-        while (!t.done()) {
-            io_uring_submit_and_wait(&ring, 1);
+        while (!t.done()) run_once(forever);
 
-            io_uring_cqe *cqe;
-            unsigned head;
+        return t.get_result();
+    }
 
-            io_uring_for_each_cqe(&ring, head, cqe) {
-                ++cqe_count;
-                auto coro = static_cast<resolver *>(io_uring_cqe_get_data(cqe));
-                if (coro) coro->resolve(cqe->res);
-            }
+    /** Submit and resolve cqes until `deadline`, for embedding the ring into the loop of
+     * another framework. The wait is bounded by the timeout argument of io_uring_enter
+     * ( IORING_ENTER_EXT_ARG, 5.11 ) instead of a timeout sqe
+     * @see io_uring_enter(2) IORING_ENTER_EXT_ARG
+     * @return number of cqes resolved
+     */
+    template <typename Clock, typename Duration>
+    unsigned run_until(const std::chrono::time_point<Clock, Duration>& deadline) noexcept {
+        unsigned count = 0;
+        do {
+            count += run_once(std::chrono::ceil<std::chrono::nanoseconds>(deadline - Clock::now()));
+        } while (Clock::now() < deadline);
+        return count;
+    }
+
+    /** Submit and resolve cqes for `timeout`
+     * @see run_until
+     * @return number of cqes resolved
+     */
+    template <typename Rep, typename Period>
+    unsigned run_for(const std::chrono::duration<Rep, Period>& timeout) noexcept {
+        return run_until(std::chrono::steady_clock::now() + timeout);
+    }
 
-            printf_if_verbose(__FILE__ ": Found %u cqe(s), looping...\n", cqe_count);
+    /** Submit and resolve the cqes ready, without blocking
+     * @return number of cqes resolved
+     */
+    unsigned poll_once() noexcept {
+        return run_once(std::chrono::nanoseconds::zero());
+    }
 
-            io_uring_cq_advance(&ring, cqe_count);
-            cqe_count = 0;
-        }
+    /** Invoke `fn()` on the thread running this io_service. Callable from any thread
+     * Functions are queued on a lock-free inbox, drained in batches by the run loop. The
+     * first one queued since the last drain wakes the ring up with an IORING_OP_MSG_RING,
+     * sent by a private ring of the calling thread
+     * @see io_uring_enter(2) IORING_OP_MSG_RING
+     * @warning `fn` must not throw: there is nobody to report it to, std::terminate is called
+     */
+    template <typename Fn>
+    void post(Fn&& fn) {
+        auto* item = new detail::posted_fn<Fn>(std::forward<Fn>(fn));
+        auto* head = inbox.load(std::memory_order_relaxed);
+        do {
+            item->next = head;
+        } while (!inbox.compare_exchange_weak(head, item, std::memory_order_release, std::memory_order_relaxed));
+        if (!head) wake_inbox();
+    }
 
-        return t.get_result();
+    /** Start a coroutine on the thread running this io_service. Callable from any thread
+     * @param fn invoked as `fn(io_service&)` there, returns the task to run. Tasks start
+     *           eagerly, so they are created on the thread running them
+     * @see post
+     */
+    template <typename Fn>
+    void spawn(Fn&& fn) {
+        post([this, fn = std::forward<Fn>(fn)]() mutable {
+            // Destructing a task that is not done detaches it
+            (void) fn(*this);
+        });
+    }
+
+    /** Resume a parked coroutine in the next pass of the run loop, without entering the kernel
+     * Used by the primitives of sync.hpp
+     * @warning only call it on the thread running the io_service
+     */
+    void schedule(detail::parked& node) noexcept {
+        ready.push_back(node);
     }
 
+    /** Wait until `count` sqes can be taken without submitting, and the CQ doesn't overflow
+     * Coroutines issuing a burst of operations should await it before taking their sqes, so that
+     * they are throttled to what the ring can take instead of panicking in io_uring_get_sqe_safe
+     * @see io_uring_enter(2) IORING_SQ_CQ_OVERFLOW IORING_FEAT_NODROP
+     * @param count number of sqes needed, up to the size of the SQ
+     * @return an awaitable resumed in FIFO order, once the run loop makes room
+     */
+    sq_space_awaitable reserve_sqes(unsigned count = 1) noexcept;
+
 public:
     /** Register files for I/O
      * @param fds fds to register
@@ -745,6 +1415,14 @@ public:
         io_uring_register_files(&ring, files, nr_files) | panic_on_err("io_uring_register_files", false);
     }
 
+    /** Register an empty file table, filled by direct descriptors
+     * @param nr_files number of slots
+     * @see io_uring_register(2) IORING_REGISTER_FILES2 IORING_RSRC_REGISTER_SPARSE
+     */
+    void register_files_sparse(unsigned nr_files) {
+        io_uring_register_files_sparse(&ring, nr_files) | panic_on_err("io_uring_register_files_sparse", false);
+    }
+
     /** Update registered files
      * @see io_uring_register(2) IORING_REGISTER_FILES_UPDATE
      */
@@ -779,6 +1457,25 @@ public:
         return io_uring_unregister_buffers(&ring);
     }
 
+public:
+    /** Register the ring fd, which is done on construction already
+     * @note a registered ring fd is only valid on the thread that registered it.
+     *       Call unregister_ring_fd() before running the io_service on another thread
+     * @see io_uring_register(2) IORING_REGISTER_RING_FDS
+     * @return 1 on success, -errno on failure
+     */
+    int register_ring_fd() noexcept {
+        return io_uring_register_ring_fd(&ring);
+    }
+
+    /** Unregister the ring fd; io_uring_enter looks the ring fd up again
+     * @see io_uring_register(2) IORING_UNREGISTER_RING_FDS
+     * @return 1 on success, -errno on failure
+     */
+    int unregister_ring_fd() noexcept {
+        return io_uring_unregister_ring_fd(&ring);
+    }
+
 public:
     /** Return internal io_uring handle */
     [[nodiscard]]
@@ -786,10 +1483,325 @@ public:
         return ring;
     }
 
+    /** io_uring_setup flags the ring was created with, after unsupported optional ones are dropped */
+    [[nodiscard]]
+    uint32_t setup_flags() const noexcept {
+        return ring.flags;
+    }
+
+    /** Number of io_uring_enter syscalls issued by this io_service, for benchmarking */
+    [[nodiscard]]
+    uint64_t syscall_count() const noexcept {
+        return syscalls;
+    }
+
 private:
+    bool sqpoll() const noexcept {
+        return ring.flags & IORING_SETUP_SQPOLL;
+    }
+
+    /** Whether the kernel holds cqes the CQ had no room for */
+    bool cq_overflow() const noexcept {
+        return __atomic_load_n(ring.sq.kflags, __ATOMIC_RELAXED) & IORING_SQ_CQ_OVERFLOW;
+    }
+
+    /** Whether io_uring_submit has to enter the kernel */
+    bool submit_needs_enter() const noexcept {
+        if (!sqpoll()) {
+            // liburing enters to flush overflowed cqes or to run task work too
+            return io_uring_sq_ready(&ring) > 0
+                || __atomic_load_n(ring.sq.kflags, __ATOMIC_RELAXED) & (IORING_SQ_CQ_OVERFLOW | IORING_SQ_TASKRUN);
+        }
+        // The poller thread picks sqes up by itself unless it's sleeping
+        return __atomic_load_n(ring.sq.kflags, __ATOMIC_RELAXED)
+            & (IORING_SQ_NEED_WAKEUP | IORING_SQ_CQ_OVERFLOW | IORING_SQ_TASKRUN);
+    }
+
+    void submit() noexcept {
+        if (submit_needs_enter()) ++syscalls;
+        check_enter(io_uring_submit(&ring));
+    }
+
+    /** The registered ring fd is only valid on the thread that registered it: anywhere else,
+     * io_uring_enter fails with -EINVAL or -EBADF, and with -EEXIST under single_issuer, so
+     * nothing would ever complete. Other errors ( -EBUSY, -EINTR, -ETIME ) are transient */
+    static void check_enter(int ret) noexcept {
+        if (__builtin_expect(ret == -EINVAL || ret == -EBADF || ret == -EEXIST, false)) {
+            panic("io_uring_enter: io_service used off the thread that built it", -ret);
+        }
+    }
+
+    /** Under SQPOLL, submit() only wakes the SQ thread up: wait until it took enough sqes for
+     * `n` free slots. The kernel consumes sqes right away otherwise */
+    void wait_sq_space(unsigned n) noexcept {
+        if (!sqpoll()) return;
+        while (io_uring_sq_space_left(&ring) < n) {
+            if (io_uring_sq_space_left(&ring) == 0) {
+                // IORING_ENTER_SQ_WAIT returns once one slot is free. On failure, the caller panics
+                ++syscalls;
+                if (int ret = io_uring_sqring_wait(&ring); ret < 0) return check_enter(ret);
+            } else {
+                sched_yield();
+            }
+        }
+    }
+
+    static constexpr auto forever = std::chrono::nanoseconds::max();
+
+    /** Submit, then wait for a cqe for `timeout` at most. Waiting for no time only runs
+     * completion work the kernel holds for this thread */
+    void submit_and_wait(std::chrono::nanoseconds timeout) noexcept {
+        if (!sqpoll()) {
+            // Cqes posted meanwhile are reaped without entering, unless completion work is
+            // pending in the kernel ( IORING_SETUP_TASKRUN_FLAG ) or cqes overflowed, which
+            // are only dealt with on enter
+            if (!io_uring_sq_ready(&ring) && io_uring_cq_ready(&ring)
+                && !(__atomic_load_n(ring.sq.kflags, __ATOMIC_RELAXED) & (IORING_SQ_TASKRUN | IORING_SQ_CQ_OVERFLOW))) return;
+
+            if (timeout <= timeout.zero()) {
+                // Without IORING_SETUP_TASKRUN_FLAG there is no telling whether deferred
+                // completion work is pending, so always enter to run it
+                if ((ring.flags & (IORING_SETUP_DEFER_TASKRUN | IORING_SETUP_TASKRUN_FLAG)) == IORING_SETUP_DEFER_TASKRUN) {
+                    ++syscalls;
+                    check_enter(io_uring_submit_and_get_events(&ring));
+                } else {
+                    submit();
+                }
+                return;
+            }
+
+            ++syscalls;
+            // Enters with IORING_ENTER_GETEVENTS, which is what runs deferred completion
+            // work ( IORING_SETUP_DEFER_TASKRUN ) on this thread
+            wait(timeout);
+            return;
+        }
+
+        submit();
+        if (io_uring_cq_ready(&ring) || timeout <= timeout.zero()) return;
+
+        if (spin_time.count() > 0) {
+            auto start = std::chrono::steady_clock::now();
+            auto deadline = start + std::min<std::chrono::nanoseconds>(spin_time, timeout);
+            do {
+                if (io_uring_cq_ready(&ring)) return;
+            } while (std::chrono::steady_clock::now() < deadline);
+            if (timeout != forever) {
+                timeout -= std::chrono::steady_clock::now() - start;
+                if (timeout <= timeout.zero()) return;
+            }
+        }
+
+        ++syscalls;
+        wait(timeout);
+    }
+
+    /** Submit and wait for a cqe in one io_uring_enter */
+    void wait(std::chrono::nanoseconds timeout) noexcept {
+        if (timeout == forever) {
+            check_enter(io_uring_submit_and_wait(&ring, 1));
+        } else {
+            // liburing falls back to a timeout sqe on kernels without IORING_FEAT_EXT_ARG,
+            // whose cqe reap() skips
+            auto ts = dur2ts(timeout);
+            io_uring_cqe* cqe;
+            check_enter(io_uring_submit_and_wait_timeout(&ring, &cqe, 1, &ts, nullptr));
+        }
+    }
+
+    /** One round of the run loop
+     * @return number of cqes resolved
+     */
+    unsigned run_once(std::chrono::nanoseconds timeout) noexcept {
+        // Coroutines waiting for SQ space only need the SQ submitted, not a cqe
+        if (sq_waiters) {
+            submit();
+        } else {
+            // Nor do scheduled ones
+            submit_and_wait(ready.empty() ? timeout : timeout.zero());
+        }
+        unsigned count = 0, batch;
+        do {
+            count += batch = reap();
+        } while (batch == reap_batch);
+        wake_sq_waiters();
+        resume_ready();
+        return count;
+    }
+
+    /** Resume the coroutines scheduled so far. Ones scheduled meanwhile wait
+     * for the next pass, so that they can't starve I/O */
+    void resume_ready() noexcept {
+        auto batch = std::exchange(ready, {});
+        while (!batch.empty()) batch.pop_front()->handle.resume();
+    }
+
+    static constexpr unsigned reap_batch = 64;
+
+    /** Resolve up to reap_batch cqes. They are copied and released to the kernel
+     * first, so that resolvers may submit, and even wait, freely
+     * @return number of cqes resolved
+     */
+    unsigned reap() noexcept {
+        io_uring_cqe batch[reap_batch];
+        io_uring_cqe *cqe;
+        unsigned head, count = 0;
+
+        io_uring_for_each_cqe(&ring, head, cqe) {
+            batch[count] = *cqe;
+            if (++count == reap_batch) break;
+        }
+        io_uring_cq_advance(&ring, count);
+
+        printf_if_verbose(__FILE__ ": Found %u cqe(s), looping...\n", count);
+        for (unsigned i = 0; i < count; ++i) {
+            // The timeout sqe of a timed wait without IORING_FEAT_EXT_ARG, not a resolver
+            if (batch[i].user_data == LIBURING_UDATA_TIMEOUT) continue;
+            resolve_user_data(batch[i].user_data, batch[i].res, batch[i].flags);
+        }
+        return count;
+    }
+
+    // Defined along with sq_space_awaitable
+    inline void wake_sq_waiters() noexcept;
+
+    friend io_uring_sqe* detail::get_linked_sqe(io_service& service, io_uring_sqe*& head) noexcept;
+
+    friend struct sq_space_awaitable;
+    /** FIFO of coroutines waiting in reserve_sqes() */
+    sq_space_awaitable* sq_waiters = nullptr;
+    sq_space_awaitable* sq_waiters_tail = nullptr;
+    /** Coroutines resumed by the next pass of the run loop, see schedule() */
+    detail::parked_list ready;
+
+    /** Resolved by the message waking the ring up for post() */
+    struct inbox_waker final: resolver {
+        explicit inbox_waker(io_service& service) noexcept: service(service) {}
+
+        void resolve(int, uint32_t) noexcept override {
+            service.drain_inbox();
+        }
+
+        io_service& service;
+    };
+
+    /** Wake the ring up to drain the inbox, from any thread */
+    void wake_inbox() {
+        detail::messenger::local().post(ring.ring_fd, to_user_data(&waker));
+    }
+
+    /** Run the functions posted so far, in order */
+    void drain_inbox() noexcept {
+        // The inbox is a stack, newest first
+        auto* items = inbox.exchange(nullptr, std::memory_order_acquire);
+        detail::posted* fifo = nullptr;
+        while (items) {
+            auto* next = items->next;
+            items->next = fifo;
+            fifo = items;
+            items = next;
+        }
+        while (fifo) {
+            std::unique_ptr<detail::posted> item(std::exchange(fifo, fifo->next));
+            item->run();
+        }
+    }
+
+    /** Functions posted from other threads, see post() */
+    std::atomic<detail::posted*> inbox = nullptr;
+    inbox_waker waker { *this };
+
+    template <typename T> friend class channel;
+    friend class runtime;
+    friend class shared_async_mutex;
+    friend class file_table;
+
+    friend class timer;
+    /** Timer wheel of a clock, created on first use */
+    detail::timer_driver& timers(clockid_t clock);
+
     io_uring ring;
-    unsigned cqe_count = 0;
+    /** One per supported clock, see timers() */
+    detail::timer_driver* timer_drivers[3] = {};
+    uint64_t syscalls = 0;
+    std::chrono::microseconds spin_time {};
     bool probe_ops[IORING_OP_LAST] = {};
 };
 
+/** Awaitable of io_service::reserve_sqes */
+struct sq_space_awaitable {
+    bool await_ready() const noexcept {
+        // Queue up behind earlier waiters, so that they aren't starved
+        return !service.sq_waiters && io_uring_sq_space_left(&service.ring) >= count && !service.cq_overflow();
+    }
+
+    void await_suspend(std::coroutine_handle<> handle) noexcept {
+        this->handle = handle;
+        if (service.sq_waiters_tail) {
+            service.sq_waiters_tail->next = this;
+        } else {
+            service.sq_waiters = this;
+        }
+        service.sq_waiters_tail = this;
+    }
+
+    constexpr void await_resume() const noexcept {}
+
+    io_service& service;
+    unsigned count;
+    sq_space_awaitable* next = nullptr;
+    std::coroutine_handle<> handle {};
+};
+
+inline sq_space_awaitable io_service::reserve_sqes(unsigned count) noexcept {
+    assert(count <= ring.sq.ring_entries && "More sqes than the SQ holds");
+    return sq_space_awaitable { *this, count };
+}
+
+inline void io_service::wake_sq_waiters() noexcept {
+    // Overflowed cqes are flushed when the next submit enters the kernel
+    while (sq_waiters && io_uring_sq_space_left(&ring) >= sq_waiters->count && !cq_overflow()) {
+        auto* waiter = sq_waiters;
+        sq_waiters = waiter->next;
+        if (!sq_waiters) sq_waiters_tail = nullptr;
+        waiter->handle.resume();
+    }
+}
+
+inline io_uring_sqe* detail::get_sqe(io_service& service) noexcept {
+    return service.io_uring_get_sqe_safe();
+}
+
+/** Take an sqe to link after `head`, the last sqe taken. If the SQ is full, the
+ * sqes before `head` are submitted without it, so that the link isn't split:
+ * `head` is moved to a new slot then */
+inline io_uring_sqe* detail::get_linked_sqe(io_service& service, io_uring_sqe*& head) noexcept {
+    auto& sq = service.ring.sq;
+    if (io_uring_sq_space_left(&service.ring) == 0) {
+        assert(head == &sq.sqes[(sq.sqe_tail - 1) & sq.ring_mask] && "Linked sqe taken after another one");
+        const io_uring_sqe held = *head;
+        --sq.sqe_tail;
+        service.submit();
+        // Both sqes must fit, or taking the second one submits the first alone
+        service.wait_sq_space(2);
+        head = service.io_uring_get_sqe_safe();
+        *head = held;
+    }
+    return service.io_uring_get_sqe_safe();
+}
+
+inline void detail::canceler::operator ()() noexcept {
+    // Nobody awaits the cancel request itself; failures ( -ENOENT, -EALREADY ) come with null user_data
+    (void) service->cancel(user_data, 0, IOSQE_CQE_SKIP_SUCCESS);
+}
+
 } // namespace uio
+
+#include <liburing/buffer_ring.hpp>
+#include <liburing/multishot_stream.hpp>
+#include <liburing/zc_send.hpp>
+#include <liburing/timer.hpp>
+#include <liburing/when_all.hpp>
+#include <liburing/file_table.hpp>
+#include <liburing/fixed_buffer_pool.hpp>
+#include <liburing/sync.hpp>
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+namespace uio {
+namespace detail {
+/**
+ * Bounded lock-free MPMC queue, after Dmitry Vyukov's. Each cell has a sequence
+ * number telling whether it's free for the producer or the consumer of a lap.
+ * The indices sit on cache lines of their own, so that producers and consumers
+ * don't bounce each other's line
+ */
+template <typename T>
+class mpmc_queue {
+public:
+    /** @param capacity a power of two */
+    explicit mpmc_queue(size_t capacity): cells(new cell[capacity]), mask(capacity - 1) {
+        assert(capacity > 0 && (capacity & mask) == 0 && "capacity must be a power of two");
+        for (size_t i = 0; i < capacity; ++i) cells[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    ~mpmc_queue() noexcept {
+        while (pop()) {}
+    }
+
+    mpmc_queue(const mpmc_queue&) = delete;
+    mpmc_queue& operator =(const mpmc_queue&) = delete;
+
+    /** Move `value` in, unless the queue is full
+     * @return false if the queue is full, `value` is left untouched then
+     */
+    bool push(T& value) noexcept(std::is_nothrow_move_constructible_v<T>) {
+        size_t pos = tail.load(std::memory_order_relaxed);
+        for (;;) {
+            auto& cell = cells[pos & mask];
+            const size_t seq = cell.seq.load(std::memory_order_acquire);
+            const auto diff = intptr_t(seq) - intptr_t(pos);
+            if (diff == 0) {
+                if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    new (cell.storage) T(std::move(value));
+                    cell.seq.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /** @return nothing if the queue is empty, or its head is still being pushed */
+    std::optional<T> pop() noexcept(std::is_nothrow_move_constructible_v<T>) {
+        size_t pos = head.load(std::memory_order_relaxed);
+        for (;;) {
+            auto& cell = cells[pos & mask];
+            const size_t seq = cell.seq.load(std::memory_order_acquire);
+            const auto diff = intptr_t(seq) - intptr_t(pos + 1);
+            if (diff == 0) {
+                if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    auto* stored = std::launder(reinterpret_cast<T *>(cell.storage));
+                    std::optional<T> value(std::move(*stored));
+                    stored->~T();
+                    cell.seq.store(pos + mask + 1, std::memory_order_release);
+                    return value;
+                }
+            } else if (diff < 0) {
+                return std::nullopt;
+            } else {
+                pos = head.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /** @return true if pop() would fail: the queue is empty, or its head is still being pushed */
+    [[nodiscard]]
+    bool empty() const noexcept {
+        const size_t pos = head.load(std::memory_order_acquire);
+        return cells[pos & mask].seq.load(std::memory_order_acquire) != pos + 1;
+    }
+
+    [[nodiscard]]
+    size_t capacity() const noexcept {
+        return mask + 1;
+    }
+
+private:
+    struct cell {
+        std::atomic<size_t> seq;
+        alignas(T) unsigned char storage[sizeof (T)];
+    };
+
+    std::unique_ptr<cell[]> cells;
+    const size_t mask;
+    alignas(64) std::atomic<size_t> head = 0;
+    alignas(64) std::atomic<size_t> tail = 0;
+};
+} // namespace detail
+} // namespace uio
@@ -0,0 +1,267 @@
+#pragma once
+
+#include <deque>
+#include <functional>
+#include <utility>
+#include <coroutine>
+#include <liburing.h>   // http://git.kernel.dk/liburing
+
+#include <liburing/io_service.hpp>
+
+namespace uio {
+/**
+ * Resolver of a multishot operation. One sqe keeps posting cqes flagged with
+ * IORING_CQE_F_MORE; the last one is posted without it.
+ * Shared by the stream and the kernel, so it outlives the stream until the
+ * last cqe arrives.
+ */
+struct multishot_resolver final {
+    static constexpr resolver_kind kind = resolver_kind::multishot;
+
+    multishot_resolver(io_service& service, std::function<void (io_uring_sqe* sqe)>&& prep)
+        : service(service), prep(std::move(prep)) {}
+
+    void resolve(int result, uint32_t flags) noexcept {
+        if (!(flags & IORING_CQE_F_MORE)) armed = false;
+        if (buffers) buffers->take(flags);
+
+        if (detached) {
+            if (drop) drop(result, flags);
+            if (!armed) delete this;
+            return;
+        }
+
+        if (result == -ENOBUFS && buffers && !armed) {
+            // Provided buffers are used up. Don't bother the consumer, but
+            // rearm once some buffers are given back to the ring. Buffers of
+            // queued completions are not available, they were taken on arrival
+            if (buffers->available()) {
+                arm();
+            } else {
+                starved = true;
+                buffers->wait_for_buffer(this);
+            }
+            return;
+        }
+
+        completions.emplace_back(result, flags);
+        if (waiter) std::exchange(waiter, nullptr).resume();
+    }
+
+    /** Issue the multishot sqe (again) */
+    void arm() noexcept {
+        auto* sqe = service.io_uring_get_sqe_safe();
+        prep(sqe);
+        set_resolver(sqe, this);
+        armed = true;
+        starved = false;
+    }
+
+    /** Called when the stream goes away; cancels the request if it's still alive */
+    void detach() noexcept {
+        if (drop) {
+            for (auto [result, flags] : completions) drop(result, flags);
+        }
+        completions.clear();
+
+        if (starved) buffers->cancel_wait(this);
+        if (!armed) {
+            delete this;
+            return;
+        }
+        detached = true;
+        auto* sqe = service.io_uring_get_sqe_safe();
+        io_uring_prep_cancel64(sqe, to_user_data(this), 0);
+        io_uring_sqe_set_data(sqe, nullptr);
+    }
+
+    io_service& service;
+    /** Fill the sqe for (re)arming */
+    std::function<void (io_uring_sqe* sqe)> prep;
+    /** Release resources held by a result nobody will consume (optional) */
+    std::function<void (int result, uint32_t flags)> drop;
+    /** Completions not yet consumed: (cqe->res, cqe->flags) */
+    std::deque<std::pair<int, uint32_t>> completions;
+    std::coroutine_handle<> waiter;
+    /** Buffer ring used with IOSQE_BUFFER_SELECT (optional) */
+    buffer_ring* buffers = nullptr;
+    bool armed = false;
+    bool detached = false;
+    /** Waiting for provided buffers after -ENOBUFS */
+    bool starved = false;
+};
+
+/**
+ * An async stream of results produced by a multishot operation
+ * `co_await stream.next()` yields one result at a time. When the kernel ends the
+ * multishot request (cqe without IORING_CQE_F_MORE), it's rearmed as soon as
+ * all pending results are consumed.
+ * @warning the stream must be destructed on the thread running its io_service;
+ *          pending operation is canceled then
+ */
+class multishot_stream {
+public:
+    explicit multishot_stream(multishot_resolver* state) noexcept: state(state) {}
+
+    multishot_stream(const multishot_stream&) = delete;
+    multishot_stream& operator =(const multishot_stream&) = delete;
+
+    multishot_stream(multishot_stream&& other) noexcept
+        : state(std::exchange(other.state, nullptr)) {}
+
+    multishot_stream& operator =(multishot_stream&& other) noexcept {
+        if (this != &other) {
+            if (state) state->detach();
+            state = std::exchange(other.state, nullptr);
+        }
+        return *this;
+    }
+
+    ~multishot_stream() noexcept {
+        if (state) state->detach();
+    }
+
+    /** Wait for the next result
+     * @return an awaitable resolved to (cqe->res, cqe->flags)
+     */
+    auto next_cqe() noexcept {
+        struct await_next {
+            multishot_resolver* state;
+
+            bool await_ready() const noexcept { return !state->completions.empty(); }
+
+            void await_suspend(std::coroutine_handle<> handle) noexcept {
+                if (!state->armed && !state->starved) state->arm();
+                state->waiter = handle;
+            }
+
+            std::pair<int, uint32_t> await_resume() const noexcept {
+                auto completion = state->completions.front();
+                state->completions.pop_front();
+                return completion;
+            }
+        };
+
+        return await_next { state };
+    }
+
+    /** Wait for the next result
+     * @return an awaitable resolved to cqe->res
+     */
+    auto next() noexcept {
+        struct await_next_result {
+            decltype(std::declval<multishot_stream>().next_cqe()) inner;
+
+            bool await_ready() const noexcept { return inner.await_ready(); }
+            void await_suspend(std::coroutine_handle<> handle) noexcept { inner.await_suspend(handle); }
+            int await_resume() const noexcept { return inner.await_resume().first; }
+        };
+
+        return await_next_result { next_cqe() };
+    }
+
+private:
+    multishot_resolver* state;
+};
+
+/**
+ * An async stream of buffers filled by a multishot request with IOSQE_BUFFER_SELECT
+ * Running out of provided buffers (-ENOBUFS) is not reported; the request is
+ * parked until a buffer is given back to the ring instead.
+ * @warning the buffer ring must outlive the stream and its pending request
+ */
+class buffer_stream {
+public:
+    buffer_stream(multishot_stream&& stream, buffer_ring& buffers) noexcept
+        : stream(std::move(stream)), buffers(&buffers) {}
+
+    /** Wait for the next buffer
+     * @return an awaitable resolved to a buffer_lease. Its result() is 0 on EOF,
+     *         or -errno on failure
+     */
+    auto next() noexcept {
+        struct await_next_buffer {
+            decltype(std::declval<multishot_stream>().next_cqe()) inner;
+            buffer_ring* buffers;
+
+            bool await_ready() const noexcept { return inner.await_ready(); }
+            void await_suspend(std::coroutine_handle<> handle) noexcept { inner.await_suspend(handle); }
+            buffer_lease await_resume() const noexcept {
+                auto [result, flags] = inner.await_resume();
+                return buffers->lease(result, flags);
+            }
+        };
+
+        return await_next_buffer { stream.next_cqe(), buffers };
+    }
+
+private:
+    multishot_stream stream;
+    buffer_ring* buffers;
+};
+
+inline void detail::resolve(multishot_resolver* resolver, int result, uint32_t flags) noexcept {
+    resolver->resolve(result, flags);
+}
+
+inline void buffer_ring::wake_starved() noexcept {
+    auto* resolver = starved.front();
+    starved.pop_front();
+    resolver->arm();
+}
+
+inline multishot_stream io_service::multishot_accept(
+    int fd,
+    int flags,
+    uint8_t iflags
+) {
+    auto* state = new multishot_resolver(*this, [=](io_uring_sqe* sqe) {
+        io_uring_prep_multishot_accept(sqe, fd, nullptr, nullptr, flags);
+        io_uring_sqe_set_flags(sqe, iflags);
+    });
+    // Accepted sockets that nobody will take must be closed
+    state->drop = [](int result, uint32_t) {
+        if (result >= 0) ::close(result);
+    };
+    state->arm();
+    return multishot_stream(state);
+}
+
+inline multishot_stream io_service::multishot_accept_direct(
+    int fd,
+    int flags,
+    uint8_t iflags
+) {
+    auto* state = new multishot_resolver(*this, [=](io_uring_sqe* sqe) {
+        io_uring_prep_multishot_accept_direct(sqe, fd, nullptr, nullptr, flags);
+        io_uring_sqe_set_flags(sqe, iflags);
+    });
+    // Slots that nobody will take must be closed
+    state->drop = [this](int result, uint32_t) {
+        if (result >= 0) close_direct(unsigned(result), IOSQE_CQE_SKIP_SUCCESS);
+    };
+    state->arm();
+    return multishot_stream(state);
+}
+
+inline buffer_stream io_service::multishot_recv(
+    int sockfd,
+    buffer_ring& buffers,
+    uint32_t flags,
+    uint8_t iflags
+) {
+    auto* state = new multishot_resolver(*this, [=, bgid = buffers.bgid()](io_uring_sqe* sqe) {
+        io_uring_prep_recv_multishot(sqe, sockfd, nullptr, 0, int(flags));
+        sqe->buf_group = bgid;
+        io_uring_sqe_set_flags(sqe, iflags | IOSQE_BUFFER_SELECT);
+    });
+    state->buffers = &buffers;
+    // Picked buffers that nobody will take must be given back
+    state->drop = [&buffers](int result, uint32_t flags) {
+        buffers.lease(result, flags);
+    };
+    state->arm();
+    return buffer_stream(multishot_stream(state), buffers);
+}
+
+} // namespace uio
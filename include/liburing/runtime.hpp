@@ -0,0 +1,437 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <coroutine>
+#include <latch>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <sched.h>
+#include <pthread.h>
+
+#include <liburing/io_service.hpp>
+
+namespace uio {
+namespace detail {
+/**
+ * Fixed size Chase-Lev deque of coroutine handles
+ * The owner pushes and pops at the bottom, other threads steal from the top
+ * @see Lê et al., Correct and Efficient Work-Stealing for Weak Memory Models
+ */
+class steal_deque {
+public:
+    static constexpr int64_t capacity = 1024;
+
+    /** Push a handle. Owner only
+     * @return false if the deque is full
+     */
+    bool push(std::coroutine_handle<> handle) noexcept {
+        const int64_t b = bottom.load(std::memory_order_relaxed);
+        const int64_t t = top.load(std::memory_order_acquire);
+        if (b - t >= capacity) return false;
+        items[b & (capacity - 1)].store(handle.address(), std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    /** Pop the handle pushed last. Owner only
+     * @return a null handle if the deque is empty
+     */
+    std::coroutine_handle<> pop() noexcept {
+        const int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+        bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top.load(std::memory_order_relaxed);
+
+        void* item = nullptr;
+        if (t <= b) {
+            item = items[b & (capacity - 1)].load(std::memory_order_relaxed);
+            if (t == b) {
+                // The last one, race with thieves
+                if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                    item = nullptr;
+                }
+                bottom.store(b + 1, std::memory_order_relaxed);
+            }
+        } else {
+            bottom.store(b + 1, std::memory_order_relaxed);
+        }
+        return std::coroutine_handle<>::from_address(item);
+    }
+
+    /** Take the handle pushed first. Callable from any thread
+     * @return a null handle if the deque is empty or another thread won the race
+     */
+    std::coroutine_handle<> steal() noexcept {
+        int64_t t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        const int64_t b = bottom.load(std::memory_order_acquire);
+        if (t >= b) return nullptr;
+
+        void* item = items[t & (capacity - 1)].load(std::memory_order_relaxed);
+        if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            return nullptr;
+        }
+        return std::coroutine_handle<>::from_address(item);
+    }
+
+private:
+    static_assert((capacity & (capacity - 1)) == 0, "capacity must be a power of 2");
+
+    alignas(64) std::atomic<int64_t> top = 0;
+    alignas(64) std::atomic<int64_t> bottom = 0;
+    std::atomic<void *> items[capacity] = {};
+};
+} // namespace detail
+
+/**
+ * Thread-per-core runtime: N threads pinned to CPUs, each running its own
+ * io_service. All rings share the io-wq of the first one ( IORING_SETUP_ATTACH_WQ ).
+ * Work is handed to a thread by posting an IORING_OP_MSG_RING to its ring, so
+ * waking up another thread needs no eventfd or lock.
+ *
+ * Each worker also has a run queue of ready coroutines, filled by `co_await rt.schedule()`.
+ * Idle workers steal from the queues of busy ones, so CPU-bound work started on
+ * a hot ring spreads over the others. Completions are never stolen: a cqe always
+ * resumes its coroutine on the ring the sqe was submitted to.
+ */
+class runtime {
+public:
+    /** Start worker threads
+     * @param threads number of threads, 0 for one per CPU the process may run on
+     * @param entries sqe entries of each ring
+     * @param flags flags used to init each io_uring
+     * @param files slots of the sparse file table registered to each ring, 0 for none
+     */
+    explicit runtime(unsigned threads = 0, int entries = 64, uint32_t flags = 0, unsigned files = 0) {
+        std::vector<int> cpus;
+        if (cpu_set_t set; sched_getaffinity(0, sizeof (set), &set) == 0) {
+            for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+                if (CPU_ISSET(cpu, &set)) cpus.push_back(cpu);
+            }
+        }
+        if (threads == 0) threads = cpus.empty() ? 1 : unsigned(cpus.size());
+
+        workers.reset(new worker[threads]);
+        count = threads;
+        std::latch started(threads);
+        for (unsigned i = 0; i < threads; ++i) {
+            int cpu = cpus.empty() ? -1 : cpus[i % cpus.size()];
+            workers[i].thread = std::thread([=, this, &started] {
+                work(i, cpu, entries, flags, files, started);
+            });
+        }
+        started.wait();
+    }
+
+    /** Stop and join all worker threads */
+    ~runtime() noexcept {
+        stop();
+        run_until_stopped();
+    }
+
+    runtime(const runtime&) = delete;
+    runtime& operator =(const runtime&) = delete;
+
+    /** Number of worker threads */
+    [[nodiscard]]
+    unsigned size() const noexcept {
+        return count;
+    }
+
+    /** io_service of a worker
+     * @warning only use it on its own thread, until the runtime stops
+     */
+    [[nodiscard]]
+    io_service& service(unsigned core) noexcept {
+        return *workers[core].service;
+    }
+
+    /** Index of the worker running the current thread, or -1 if it's not one of ours */
+    [[nodiscard]]
+    int current_core() const noexcept {
+        return current_runtime == this ? int(current_index) : -1;
+    }
+
+    /** Invoke `fn()` on a worker thread. Once the runtime is stopping, `fn` is dropped instead
+     * @see io_uring_enter(2) IORING_OP_MSG_RING
+     * @note on a worker thread, the message is sent by the next submission of its
+     *       own ring. Other threads send it synchronously through a private ring.
+     */
+    template <typename Fn>
+    void post(unsigned core, Fn&& fn) {
+        deliver(core, std::forward<Fn>(fn), false);
+    }
+
+    /** Move a registered file of `from` into the file table of a worker, then close its slot in `from`
+     * @see io_uring_enter(2) IORING_OP_MSG_RING IORING_MSG_SEND_FD
+     * @param from ring of the calling thread, holding the file in slot `file_index`
+     * @param resolver invoked on the worker with the slot the file is installed into. If the
+     *        file can't be sent, it's invoked on the calling thread with -errno instead,
+     *        -ECANCELED once the runtime is stopping
+     */
+    void send_file(io_service& from, unsigned core, unsigned file_index, callback_resolver* resolver) {
+        // Submitted before the guard is left, so that the worker keeps its ring until the file is sent
+        sending.fetch_add(1, std::memory_order_seq_cst);
+        on_scope_exit done([this] { sending.fetch_sub(1, std::memory_order_release); });
+        if (stopping.load(std::memory_order_seq_cst)) {
+            (void) from.close_direct(file_index, IOSQE_CQE_SKIP_SUCCESS);
+            resolver->resolve(-ECANCELED);
+            return;
+        }
+
+        auto op = from.send_fd(workers[core].ring_fd, file_index, IORING_FILE_INDEX_ALLOC,
+            to_user_data(resolver), IOSQE_IO_HARDLINK | IOSQE_CQE_SKIP_SUCCESS);
+        // Only a failed send posts a cqe to `from`
+        io_uring_sqe_set_data64(op.sqe, to_user_data(resolver));
+        // Both sqes go in one submission, or the close may run before the file is sent
+        auto* close_sqe = detail::get_linked_sqe(from, op.sqe);
+        // The worker holds its own reference to the file now
+        io_uring_prep_close_direct(close_sqe, file_index);
+        io_uring_sqe_set_flags(close_sqe, IOSQE_CQE_SKIP_SUCCESS);
+        from.submit();
+    }
+
+    /** Start a coroutine on a worker thread
+     * @param fn invoked as `fn(io_service&)` on the worker, returns the task or `stealable` to run there.
+     *           Both start eagerly, so they are created on the thread running them
+     */
+    template <typename Fn>
+    void spawn_on(unsigned core, Fn&& fn) {
+        post(core, [this, core, fn = std::forward<Fn>(fn)]() mutable {
+            // Destructing a task that is not done detaches it, a stealable has no owner anyway
+            (void) fn(service(core));
+        });
+    }
+
+    /** Put the current coroutine into the run queue of this worker, where idle workers may steal it
+     * @return an awaitable resolved to the io_service of the worker resuming the coroutine.
+     *         The coroutine may be resumed on another thread; use that service for later operations
+     * @note only a `stealable` coroutine may be moved: a task has an owner or a parent on its
+     *       own thread, which would touch it while another thread runs it
+     * @warning only callable on a worker thread. Coroutines still queued when the runtime stops are leaked
+     */
+    auto schedule() noexcept {
+        struct await_schedule {
+            runtime& rt;
+
+            bool await_ready() const noexcept { return false; }
+
+            bool await_suspend(std::coroutine_handle<stealable::promise_type> handle) noexcept {
+                // Once pushed, the coroutine may be stolen, resumed and destroyed at any time:
+                // nothing of its frame, this awaiter included, may be touched after that
+                runtime& rt = this->rt;
+                assert(rt.current_runtime == &rt && "schedule() is called outside of workers");
+                auto& self = rt.workers[rt.current_index];
+                // Just go on if the queue is full
+                if (!self.ready.push(handle)) return false;
+
+                self.idle.store(false, std::memory_order_relaxed);
+                if (!self.draining) {
+                    self.draining = true;
+                    // Drain the queue once the ring is entered, so that pending cqes are not delayed
+                    self.service->yield().set_callback([&rt](int) { rt.drain(); });
+                }
+                rt.wake_idle_worker();
+                return true;
+            }
+
+            io_service& await_resume() const noexcept {
+                return *rt.workers[rt.current_index].service;
+            }
+        };
+
+        return await_schedule { *this };
+    }
+
+    /** Let all workers return once they process the request. Callable from any thread
+     * Posts are refused from now on
+     */
+    void stop() {
+        if (stopping.exchange(true)) return;
+        for (unsigned i = 0; i < size(); ++i) {
+            deliver(i, [this, i] {
+                std::exchange(workers[i].stop_waiter, nullptr).resume();
+            }, true);
+        }
+    }
+
+    /** Block until stop() is called and all workers are joined */
+    void run_until_stopped() {
+        for (unsigned i = 0; i < count; ++i) {
+            if (workers[i].thread.joinable()) workers[i].thread.join();
+        }
+    }
+
+private:
+    struct alignas(64) worker {
+        std::thread thread;
+        /** Owned by the worker thread, null once it's gone */
+        io_service* service = nullptr;
+        /** Ring of `service`, read by senders of other threads */
+        int ring_fd = -1;
+        std::coroutine_handle<> stop_waiter;
+        detail::steal_deque ready;
+        /** A drain of the run queue is pending or running. Owner only */
+        bool draining = false;
+        /** Nothing to run or steal, the worker may be woken up to steal */
+        std::atomic<bool> idle = true;
+    };
+
+    /** Coroutines resumed by one drain before pending cqes get their turn */
+    static constexpr unsigned drain_batch = 64;
+
+    void work(unsigned index, int cpu, int entries, uint32_t flags, unsigned files, std::latch& started) {
+        if (cpu >= 0) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(cpu, &set);
+            pthread_setaffinity_np(pthread_self(), sizeof (set), &set);
+        }
+
+        // Rings after the first one attach to its io-wq
+        if (index > 0) wq_ready.wait();
+        io_service service(entries, index > 0 ? flags | IORING_SETUP_ATTACH_WQ : flags, index > 0 ? wq_fd : 0);
+        if (index == 0) {
+            wq_fd = uint32_t(service.get_handle().ring_fd);
+            wq_ready.count_down();
+        }
+        if (files) service.register_files_sparse(files);
+
+        current_runtime = this;
+        current_index = index;
+        auto& self = workers[index];
+        self.service = &service;
+        self.ring_fd = service.get_handle().ring_fd;
+
+        auto main = [](worker& self) -> task<> {
+            struct await_stop {
+                worker& self;
+                bool await_ready() const noexcept { return false; }
+                void await_suspend(std::coroutine_handle<> handle) noexcept { self.stop_waiter = handle; }
+                void await_resume() const noexcept {}
+            };
+            co_await await_stop { self };
+        }(self);
+        started.count_down();
+
+        service.run(main);
+        leave(service);
+        self.service = nullptr;
+        current_runtime = nullptr;
+    }
+
+    /** Keep the ring of a stopped worker alive until nothing can be sent to it anymore */
+    void leave(io_service& service) {
+        // Messages queued on this ring go out now, while their targets are alive
+        service.poll_once();
+        // Posts of other threads are refused once stopping; wait for the ones already started
+        while (sending.load(std::memory_order_seq_cst) > 0) std::this_thread::yield();
+
+        const unsigned arrived = exited.fetch_add(1, std::memory_order_acq_rel) + 1;
+        if (arrived == count) {
+            exited.notify_all();
+        } else {
+            for (unsigned n = arrived; n < count; n = exited.load(std::memory_order_acquire)) exited.wait(n);
+        }
+        // Every worker has flushed its messages: run the ones sent here meanwhile
+        service.poll_once();
+    }
+
+    /** Post `fn` to a worker, or drop it if the runtime is stopping, unless `force` */
+    template <typename Fn>
+    void deliver(unsigned core, Fn&& fn, bool force) {
+        auto* resolver = callback_resolver::create([fn = std::forward<Fn>(fn)](int result) mutable {
+            if (result >= 0) fn();
+        });
+        // Frees the resolver without invoking `fn`
+        if (!send(core, to_user_data(resolver), force)) resolver->resolve(-ECANCELED);
+    }
+
+    /** Resume ready coroutines of the current worker, stealing from others once it runs out */
+    void drain() noexcept {
+        auto& self = workers[current_index];
+        for (unsigned i = 0; i < drain_batch; ++i) {
+            auto handle = self.ready.pop();
+            if (!handle) handle = steal();
+            if (!handle) {
+                self.draining = false;
+                self.idle.store(true, std::memory_order_relaxed);
+                return;
+            }
+            handle.resume();
+        }
+        self.service->yield().set_callback([this](int) { drain(); });
+    }
+
+    std::coroutine_handle<> steal() noexcept {
+        for (unsigned i = 1; i < count; ++i) {
+            auto& victim = workers[(current_index + i) % count];
+            if (auto handle = victim.ready.steal()) return handle;
+        }
+        return nullptr;
+    }
+
+    /** Ask one idle worker to steal from the others */
+    void wake_idle_worker() {
+        for (unsigned i = 1; i < count; ++i) {
+            const unsigned core = (current_index + i) % count;
+            auto& other = workers[core];
+            if (other.idle.load(std::memory_order_relaxed) && other.idle.exchange(false, std::memory_order_relaxed)) {
+                post(core, [this] {
+                    auto& self = workers[current_index];
+                    if (!self.draining) {
+                        self.draining = true;
+                        drain();
+                    }
+                });
+                return;
+            }
+        }
+    }
+
+    /** Send a message to the ring of a worker
+     * @param data user_data resolved on the worker. If a worker fails to send it, it's resolved
+     *        on the sending ring with -errno instead; other threads throw
+     * @return false if the runtime is stopping and `force` isn't set
+     */
+    bool send(unsigned core, uint64_t data, bool force = false) {
+        // Pairs with leave(): either the worker waits for this send, or this send sees stopping
+        sending.fetch_add(1, std::memory_order_seq_cst);
+        if (stopping.load(std::memory_order_seq_cst) && !force) {
+            sending.fetch_sub(1, std::memory_order_release);
+            return false;
+        }
+
+        const int fd = workers[core].ring_fd;
+        if (current_runtime == this) {
+            // Submitted by this worker before it leaves
+            auto* sqe = workers[current_index].service->io_uring_get_sqe_safe();
+            io_uring_prep_msg_ring(sqe, fd, 0, data, 0);
+            // Only a failed send posts a cqe to this ring, resolving `data` here with -errno
+            io_uring_sqe_set_data64(sqe, data);
+            io_uring_sqe_set_flags(sqe, IOSQE_CQE_SKIP_SUCCESS);
+        } else {
+            detail::messenger::local().post(fd, data);
+        }
+        sending.fetch_sub(1, std::memory_order_release);
+        return true;
+    }
+
+    static inline thread_local runtime* current_runtime = nullptr;
+    static inline thread_local unsigned current_index = 0;
+
+    std::unique_ptr<worker[]> workers;
+    unsigned count = 0;
+    std::latch wq_ready { 1 };
+    uint32_t wq_fd = 0;
+    std::atomic<bool> stopping = false;
+    /** Sends in progress, see leave() */
+    std::atomic<unsigned> sending = 0;
+    /** Workers done with their ring */
+    std::atomic<unsigned> exited = 0;
+};
+
+} // namespace uio
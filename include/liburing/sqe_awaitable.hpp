@@ -1,33 +1,90 @@
 #pragma once
 
 #include <climits>
+#include <cstdint>
+#include <cstddef>
 #include <liburing.h>
 #include <type_traits>
 #include <optional>
 #include <cassert>
+#include <cerrno>
+#include <chrono>
 #include <coroutine>
+#include <new>
+#include <stop_token>
+#include <utility>
+
+#include <liburing/frame_allocator.hpp>
 
 namespace uio {
+/**
+ * What a cqe resolves, encoded in the low bits of user_data. All resolvers are
+ * aligned to at least 8 bytes, so the pointer keeps its upper bits.
+ * The cqe loop switches over the kind instead of calling a virtual function.
+ */
+enum class resolver_kind: uint64_t {
+    /** A class derived from uio::resolver, dispatched virtually */
+    custom = 0,
+    resume,
+    deferred,
+    callback,
+    multishot,
+    zero_copy,
+    linked_timeout,
+    /** An sqe_awaitable joined by when_all / when_any */
+    join_child,
+};
+inline constexpr uint64_t resolver_kind_mask = 7;
+
+/** Base class of user defined resolvers, for completions the built-in kinds don't cover */
 struct resolver {
-    virtual void resolve(int result) noexcept = 0;
+    static constexpr resolver_kind kind = resolver_kind::custom;
+
+    virtual void resolve(int result, uint32_t flags) noexcept = 0;
 };
 
-struct resume_resolver final: resolver {
+/** Encode a resolver into user_data */
+template <typename Resolver>
+[[nodiscard]]
+inline uint64_t to_user_data(Resolver* resolver) noexcept {
+    static_assert(alignof(Resolver) > resolver_kind_mask, "Resolver must leave room for the kind tag");
+    return uint64_t(reinterpret_cast<uintptr_t>(resolver)) | uint64_t(Resolver::kind);
+}
+
+/** Let `resolver` be resolved by the cqe of `sqe` */
+template <typename Resolver>
+inline void set_resolver(io_uring_sqe* sqe, Resolver* resolver) noexcept {
+    io_uring_sqe_set_data64(sqe, to_user_data(resolver));
+}
+
+template <typename T>
+class channel;
+
+struct resume_resolver final {
+    static constexpr resolver_kind kind = resolver_kind::resume;
+
     friend struct sqe_awaitable;
+    friend struct buffer_awaitable;
+    friend struct fixed_fd_awaitable;
+    template <typename T> friend class channel;
 
-    void resolve(int result) noexcept override {
+    void resolve(int result, uint32_t flags) noexcept {
         this->result = result;
+        this->flags = flags;
         handle.resume();
     }
 
 private:
     std::coroutine_handle<> handle;
     int result = 0;
+    uint32_t flags = 0;
 };
 static_assert(std::is_trivially_destructible_v<resume_resolver>);
 
-struct deferred_resolver final: resolver {
-    void resolve(int result) noexcept override {
+struct alignas(8) deferred_resolver final {
+    static constexpr resolver_kind kind = resolver_kind::deferred;
+
+    void resolve(int result) noexcept {
         this->result = result;
     }
 
@@ -40,29 +97,173 @@ struct deferred_resolver final: resolver {
     std::optional<int> result;
 };
 
-struct callback_resolver final: resolver {
-    callback_resolver(std::function<void (int result)>&& cb): cb(std::move(cb)) {}
+/**
+ * A callback invoked with the result of an operation
+ * Callables up to `inline_size` bytes are stored inline, in a block recycled by
+ * the thread-local frame pool; bigger ones are moved to the heap.
+ */
+struct callback_resolver final {
+    static constexpr resolver_kind kind = resolver_kind::callback;
+    static constexpr size_t inline_size = 48;
 
-    void resolve(int result) noexcept override {
-        this->cb(result);
-        delete this;
+    template <typename Fn>
+    static callback_resolver* create(Fn&& fn) {
+        using F = std::decay_t<Fn>;
+        auto* self = new (detail::frame_pool::allocate_local(sizeof (callback_resolver))) callback_resolver();
+
+        if constexpr (sizeof (F) <= inline_size && alignof(F) <= alignof(std::max_align_t)) {
+            new (self->storage) F(std::forward<Fn>(fn));
+            self->invoke = [](callback_resolver* self, int result) {
+                auto* f = std::launder(reinterpret_cast<F *>(self->storage));
+                (*f)(result);
+                f->~F();
+                self->release();
+            };
+        } else {
+            new (self->storage) F*(new F(std::forward<Fn>(fn)));
+            self->invoke = [](callback_resolver* self, int result) {
+                auto* f = *std::launder(reinterpret_cast<F **>(self->storage));
+                (*f)(result);
+                delete f;
+                self->release();
+            };
+        }
+        return self;
+    }
+
+    /** Invoke the callback and free this resolver */
+    void resolve(int result) noexcept {
+        invoke(this, result);
     }
 
 private:
-    std::function<void (int result)> cb;
+    callback_resolver() = default;
+
+    void release() noexcept {
+        detail::frame_pool::deallocate_local(this, sizeof (callback_resolver));
+    }
+
+    void (*invoke)(callback_resolver* self, int result);
+    alignas(std::max_align_t) unsigned char storage[inline_size];
+};
+
+/**
+ * Resolves an operation linked to an IORING_OP_LINK_TIMEOUT
+ * The coroutine is resumed once both cqes arrive, in whichever order they come
+ */
+struct linked_timeout_resolver final {
+    /** What the cqe of each sqe resolves */
+    struct alignas(8) part {
+        static constexpr resolver_kind kind = resolver_kind::linked_timeout;
+
+        linked_timeout_resolver* owner;
+        bool timer;
+    };
+
+    void resolve(const part& from, int result, uint32_t flags) noexcept {
+        if (from.timer) {
+            timed_out = result == -ETIME;
+        } else {
+            this->result = result;
+            this->flags = flags;
+        }
+        if (--pending == 0) {
+            // The operation was canceled by the timer
+            if (timed_out && this->result == -ECANCELED) this->result = -ETIME;
+            handle.resume();
+        }
+    }
+
+    part op { this, false };
+    part timer { this, true };
+    std::coroutine_handle<> handle;
+    int result = 0;
+    uint32_t flags = 0;
+    unsigned pending = 2;
+    bool timed_out = false;
+};
+
+struct multishot_resolver;
+struct zc_resolver;
+
+namespace detail {
+struct sqe_child;
+
+// Defined along with the resolvers
+inline void resolve(multishot_resolver* resolver, int result, uint32_t flags) noexcept;
+inline void resolve(zc_resolver* resolver, int result, uint32_t flags) noexcept;
+inline void resolve(sqe_child* child, int result, uint32_t flags) noexcept;
+} // namespace detail
+
+/** Resolve what user_data of a cqe refers to. Null user_data is ignored */
+inline void resolve_user_data(uint64_t user_data, int result, uint32_t flags) noexcept {
+    void* ptr = reinterpret_cast<void *>(uintptr_t(user_data & ~resolver_kind_mask));
+    switch (resolver_kind(user_data & resolver_kind_mask)) {
+    case resolver_kind::resume:
+        static_cast<resume_resolver *>(ptr)->resolve(result, flags);
+        break;
+    case resolver_kind::deferred:
+        static_cast<deferred_resolver *>(ptr)->resolve(result);
+        break;
+    case resolver_kind::callback:
+        static_cast<callback_resolver *>(ptr)->resolve(result);
+        break;
+    case resolver_kind::multishot:
+        detail::resolve(static_cast<multishot_resolver *>(ptr), result, flags);
+        break;
+    case resolver_kind::zero_copy:
+        detail::resolve(static_cast<zc_resolver *>(ptr), result, flags);
+        break;
+    case resolver_kind::linked_timeout: {
+        auto* part = static_cast<linked_timeout_resolver::part *>(ptr);
+        part->owner->resolve(*part, result, flags);
+        break;
+    }
+    case resolver_kind::join_child:
+        detail::resolve(static_cast<detail::sqe_child *>(ptr), result, flags);
+        break;
+    case resolver_kind::custom:
+        if (ptr) static_cast<resolver *>(ptr)->resolve(result, flags);
+        break;
+    default:
+        __builtin_unreachable();
+    }
+}
+
+/** Cancels the operations it's attached to once its std::stop_source is stopped */
+using cancel_token = std::stop_token;
+using stop_source = std::stop_source;
+
+class io_service;
+
+namespace detail {
+/** Submits IORING_OP_ASYNC_CANCEL for a request, invoked by std::stop_callback */
+struct canceler {
+    io_service* service;
+    uint64_t user_data;
+
+    // Defined along with io_service
+    inline void operator ()() noexcept;
 };
 
+// Defined along with io_service
+inline io_uring_sqe* get_sqe(io_service& service) noexcept;
+inline io_uring_sqe* get_linked_sqe(io_service& service, io_uring_sqe*& head) noexcept;
+} // namespace detail
+
+class shared_async_mutex;
+
 struct sqe_awaitable {
-    // TODO: use cancel_token to implement cancellation
-    sqe_awaitable(io_uring_sqe* sqe) noexcept: sqe(sqe) {}
+    sqe_awaitable(io_uring_sqe* sqe, io_service* service = nullptr) noexcept: sqe(sqe), service(service) {}
 
     // User MUST keep resolver alive before the operation is finished
     void set_deferred(deferred_resolver& resolver) {
-        io_uring_sqe_set_data(sqe, &resolver);
+        set_resolver(sqe, &resolver);
     }
 
-    void set_callback(std::function<void (int result)> cb) {
-        io_uring_sqe_set_data(sqe, new callback_resolver(std::move(cb)));
+    template <typename Fn>
+    void set_callback(Fn&& cb) {
+        set_resolver(sqe, callback_resolver::create(std::forward<Fn>(cb)));
     }
 
     auto operator co_await() {
@@ -76,7 +277,7 @@ struct sqe_awaitable {
 
             void await_suspend(std::coroutine_handle<> handle) noexcept {
                 resolver.handle = handle;
-                io_uring_sqe_set_data(sqe, &resolver);
+                set_resolver(sqe, &resolver);
             }
 
             constexpr int await_resume() const noexcept { return resolver.result; }
@@ -85,8 +286,86 @@ struct sqe_awaitable {
         return await_sqe(sqe);
     }
 
+    /** Cancel the operation ( IORING_OP_ASYNC_CANCEL ) when `token` is stopped while it's awaited
+     * @return an awaitable resolved to the result of the operation, -ECANCELED if it's canceled in time
+     * @warning stop the source on the thread running the io_service
+     */
+    auto cancel_on(cancel_token token) noexcept {
+        assert(service && "The operation doesn't come from an io_service");
+        struct await_cancellable {
+            resume_resolver resolver {};
+            io_uring_sqe* sqe;
+            io_service* service;
+            cancel_token token;
+            std::optional<std::stop_callback<detail::canceler>> callback {};
+
+            constexpr bool await_ready() const noexcept { return false; }
+
+            void await_suspend(std::coroutine_handle<> handle) noexcept {
+                resolver.handle = handle;
+                set_resolver(sqe, &resolver);
+                // Invoked immediately if stopped already. The cancel request is queued after
+                // the operation, so it finds the operation anyway
+                callback.emplace(std::move(token), detail::canceler { service, to_user_data(&resolver) });
+            }
+
+            int await_resume() noexcept {
+                callback.reset();
+                return resolver.result;
+            }
+        };
+
+        return await_cancellable { .sqe = sqe, .service = service, .token = std::move(token) };
+    }
+
+    /** Fail the operation with -ETIME if it doesn't finish in `timeout`
+     * An IORING_OP_LINK_TIMEOUT is linked to the operation, so it must be awaited
+     * right after the operation is created, before any other sqe is taken
+     * @see io_uring_enter(2) IORING_OP_LINK_TIMEOUT
+     * @return an awaitable resolved to the result of the operation, or -ETIME
+     * @warning the cqe of the operation must not be skipped ( IOSQE_CQE_SKIP_SUCCESS )
+     */
+    auto with_timeout(std::chrono::nanoseconds timeout) noexcept {
+        assert(service && "The operation doesn't come from an io_service");
+        struct await_timeout {
+            linked_timeout_resolver resolver {};
+            io_uring_sqe* sqe;
+            io_uring_sqe* timeout_sqe;
+            __kernel_timespec ts;
+
+            constexpr bool await_ready() const noexcept { return false; }
+
+            void await_suspend(std::coroutine_handle<> handle) noexcept {
+                resolver.handle = handle;
+                set_resolver(sqe, &resolver.op);
+                set_resolver(timeout_sqe, &resolver.timer);
+                // Read when it's submitted, the awaiter lives until both cqes arrive
+                timeout_sqe->addr = reinterpret_cast<uintptr_t>(&ts);
+            }
+
+            constexpr int await_resume() const noexcept { return resolver.result; }
+        };
+
+        // May move the sqe of the operation, so that it's submitted along with the timeout
+        auto* timeout_sqe = detail::get_linked_sqe(*service, sqe);
+        sqe->flags |= IOSQE_IO_LINK;
+        io_uring_prep_link_timeout(timeout_sqe, nullptr, 0);
+
+        const auto secs = std::chrono::duration_cast<std::chrono::seconds>(timeout);
+        return await_timeout {
+            .sqe = sqe,
+            .timeout_sqe = timeout_sqe,
+            .ts = { secs.count(), (timeout - secs).count() },
+        };
+    }
+
 private:
+    friend struct detail::sqe_child;
+    friend class shared_async_mutex;
+    friend class runtime;
+
     io_uring_sqe* sqe;
+    io_service* service;
 };
 
 } // namespace uio
@@ -0,0 +1,417 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <coroutine>
+#include <cstddef>
+#include <mutex>
+
+#include <liburing/io_service.hpp>
+
+namespace uio {
+// Synchronization primitives for coroutines of one io_service. Waiters are parked
+// in intrusive lists living in their own frames, and resumed by the next pass of
+// the run loop ( io_service::schedule ), so that nothing enters the kernel.
+// They are not thread-safe: use them on the thread running the io_service only
+
+namespace detail {
+/** Awaiter parking the caller on a list of a primitive unless `ready` says it can go on */
+template <typename Primitive>
+struct park_awaiter {
+    bool await_ready() noexcept {
+        return primitive.ready();
+    }
+
+    void await_suspend(std::coroutine_handle<> handle) noexcept {
+        node.handle = handle;
+        primitive.waiters.push_back(node);
+    }
+
+    constexpr void await_resume() const noexcept {}
+
+    Primitive& primitive;
+    parked node {};
+};
+} // namespace detail
+
+/**
+ * Mutex whose lock() suspends the caller instead of blocking the thread
+ * Ownership is handed to waiters in FIFO order
+ */
+class async_mutex {
+public:
+    explicit async_mutex(io_service& service) noexcept: service(service) {}
+
+    ~async_mutex() noexcept {
+        assert(waiters.empty() && "async_mutex destroyed with waiters");
+    }
+
+    async_mutex(const async_mutex&) = delete;
+    async_mutex& operator =(const async_mutex&) = delete;
+
+    /** Lock the mutex
+     * @return an awaitable resumed once the mutex is owned
+     */
+    [[nodiscard]]
+    detail::park_awaiter<async_mutex> lock() noexcept {
+        return { *this };
+    }
+
+    /** Lock the mutex
+     * @return an awaitable resolved to a std::unique_lock owning the mutex
+     */
+    [[nodiscard]]
+    auto scoped_lock() noexcept {
+        struct awaiter: detail::park_awaiter<async_mutex> {
+            std::unique_lock<async_mutex> await_resume() const noexcept {
+                return std::unique_lock<async_mutex>(primitive, std::adopt_lock);
+            }
+        };
+        return awaiter { { *this } };
+    }
+
+    bool try_lock() noexcept {
+        if (locked) return false;
+        locked = true;
+        return true;
+    }
+
+    /** Unlock the mutex, or hand it to the first waiter */
+    void unlock() noexcept {
+        assert(locked && "async_mutex is not locked");
+        if (waiters.empty()) {
+            locked = false;
+        } else {
+            service.schedule(*waiters.pop_front());
+        }
+    }
+
+private:
+    friend struct detail::park_awaiter<async_mutex>;
+    friend class async_condition_variable;
+
+    bool ready() noexcept {
+        return try_lock();
+    }
+
+    io_service& service;
+    detail::parked_list waiters;
+    bool locked = false;
+};
+
+/**
+ * Counting semaphore whose acquire() suspends the caller instead of blocking the thread
+ * Permits are handed to waiters in FIFO order
+ */
+class async_semaphore {
+public:
+    async_semaphore(io_service& service, size_t initial) noexcept: service(service), count(initial) {}
+
+    ~async_semaphore() noexcept {
+        assert(waiters.empty() && "async_semaphore destroyed with waiters");
+    }
+
+    async_semaphore(const async_semaphore&) = delete;
+    async_semaphore& operator =(const async_semaphore&) = delete;
+
+    /** Take a permit
+     * @return an awaitable resumed once a permit is taken
+     */
+    [[nodiscard]]
+    detail::park_awaiter<async_semaphore> acquire() noexcept {
+        return { *this };
+    }
+
+    bool try_acquire() noexcept {
+        // Waiters come first
+        if (count == 0 || !waiters.empty()) return false;
+        --count;
+        return true;
+    }
+
+    /** Give `update` permits back, to waiters first */
+    void release(size_t update = 1) noexcept {
+        for (; update > 0 && !waiters.empty(); --update) service.schedule(*waiters.pop_front());
+        count += update;
+    }
+
+    /** Number of permits left */
+    [[nodiscard]]
+    size_t available() const noexcept {
+        return count;
+    }
+
+private:
+    friend struct detail::park_awaiter<async_semaphore>;
+
+    bool ready() noexcept {
+        return try_acquire();
+    }
+
+    io_service& service;
+    detail::parked_list waiters;
+    size_t count;
+};
+
+/**
+ * Condition variable for async_mutex. A notified waiter is moved onto the queue
+ * of its mutex rather than resumed, so it wakes up owning the mutex
+ */
+class async_condition_variable {
+public:
+    explicit async_condition_variable(io_service& service) noexcept: service(service) {}
+
+    ~async_condition_variable() noexcept {
+        assert(waiters.empty() && "async_condition_variable destroyed with waiters");
+    }
+
+    async_condition_variable(const async_condition_variable&) = delete;
+    async_condition_variable& operator =(const async_condition_variable&) = delete;
+
+    /** Unlock `mutex` and wait for a notification
+     * @param mutex locked by the caller
+     * @return an awaitable resumed with `mutex` locked again
+     */
+    [[nodiscard]]
+    auto wait(async_mutex& mutex) noexcept {
+        struct awaiter {
+            constexpr bool await_ready() const noexcept { return false; }
+
+            void await_suspend(std::coroutine_handle<> handle) noexcept {
+                node.handle = handle;
+                node.mutex = &mutex;
+                cv.waiters.push_back(node);
+                mutex.unlock();
+            }
+
+            constexpr void await_resume() const noexcept {}
+
+            async_condition_variable& cv;
+            async_mutex& mutex;
+            waiter node {};
+        };
+        return awaiter { *this, mutex };
+    }
+
+    /** Wait until `pred` holds
+     * @param mutex locked by the caller, and while `pred` is called
+     */
+    template <typename Pred>
+    task<> wait(async_mutex& mutex, Pred pred) {
+        while (!pred()) co_await wait(mutex);
+    }
+
+    void notify_one() noexcept {
+        if (!waiters.empty()) requeue(*waiters.pop_front());
+    }
+
+    void notify_all() noexcept {
+        while (!waiters.empty()) requeue(*waiters.pop_front());
+    }
+
+private:
+    struct waiter: detail::parked {
+        async_mutex* mutex;
+    };
+
+    void requeue(detail::parked& node) noexcept {
+        auto& mutex = *static_cast<waiter&>(node).mutex;
+        if (mutex.try_lock()) {
+            service.schedule(node);
+        } else {
+            mutex.waiters.push_back(node);
+        }
+    }
+
+    io_service& service;
+    detail::parked_list waiters;
+};
+
+/**
+ * Single-use barrier: waiters are resumed once the counter reaches zero
+ */
+class async_latch {
+public:
+    async_latch(io_service& service, size_t expected) noexcept: service(service), count(expected) {}
+
+    ~async_latch() noexcept {
+        assert(waiters.empty() && "async_latch destroyed with waiters");
+    }
+
+    async_latch(const async_latch&) = delete;
+    async_latch& operator =(const async_latch&) = delete;
+
+    /** Decrease the counter, resuming the waiters when it reaches zero */
+    void count_down(size_t update = 1) noexcept {
+        assert(update <= count && "async_latch counted down below zero");
+        count -= update;
+        if (count == 0) {
+            while (!waiters.empty()) service.schedule(*waiters.pop_front());
+        }
+    }
+
+    [[nodiscard]]
+    bool try_wait() const noexcept {
+        return count == 0;
+    }
+
+    /** Wait for the counter to reach zero */
+    [[nodiscard]]
+    detail::park_awaiter<async_latch> wait() noexcept {
+        return { *this };
+    }
+
+    /** count_down(update), then wait */
+    [[nodiscard]]
+    detail::park_awaiter<async_latch> arrive_and_wait(size_t update = 1) noexcept {
+        count_down(update);
+        return wait();
+    }
+
+private:
+    friend struct detail::park_awaiter<async_latch>;
+
+    bool ready() const noexcept {
+        return try_wait();
+    }
+
+    io_service& service;
+    detail::parked_list waiters;
+    size_t count;
+};
+
+/**
+ * Manual-reset event: waiters are resumed once it's set, until it's reset
+ */
+class async_event {
+public:
+    explicit async_event(io_service& service, bool set = false) noexcept: service(service), signaled(set) {}
+
+    ~async_event() noexcept {
+        assert(waiters.empty() && "async_event destroyed with waiters");
+    }
+
+    async_event(const async_event&) = delete;
+    async_event& operator =(const async_event&) = delete;
+
+    /** Set the event, resuming all waiters */
+    void set() noexcept {
+        signaled = true;
+        while (!waiters.empty()) service.schedule(*waiters.pop_front());
+    }
+
+    void reset() noexcept {
+        signaled = false;
+    }
+
+    [[nodiscard]]
+    bool is_set() const noexcept {
+        return signaled;
+    }
+
+    /** Wait for the event to be set */
+    [[nodiscard]]
+    detail::park_awaiter<async_event> wait() noexcept {
+        return { *this };
+    }
+
+private:
+    friend struct detail::park_awaiter<async_event>;
+
+    bool ready() const noexcept {
+        return signaled;
+    }
+
+    io_service& service;
+    detail::parked_list waiters;
+    bool signaled;
+};
+
+/**
+ * Mutex shared by coroutines of rings on different threads. Locking it uncontended is
+ * a single CAS; a contended lock waits in the ring ( IORING_OP_FUTEX_WAIT, 6.7 ), so
+ * the thread keeps running its other coroutines meanwhile
+ * @note the futex word follows "Futexes Are Tricky": 0 unlocked, 1 locked, 2 locked with waiters
+ */
+class shared_async_mutex {
+public:
+    shared_async_mutex() noexcept = default;
+
+    shared_async_mutex(const shared_async_mutex&) = delete;
+    shared_async_mutex& operator =(const shared_async_mutex&) = delete;
+
+    /** Awaitable of lock(), waiting on the futex until it takes the mutex */
+    struct lock_awaitable final: resolver {
+        lock_awaitable(shared_async_mutex& mutex, io_service& service) noexcept: mutex(mutex), service(service) {}
+
+        bool await_ready() noexcept {
+            return mutex.try_lock();
+        }
+
+        bool await_suspend(std::coroutine_handle<> handle) noexcept {
+            this->handle = handle;
+            return !mutex.acquire_or_wait(service, this);
+        }
+
+        constexpr void await_resume() const noexcept {}
+
+        void resolve(int result, uint32_t) noexcept override {
+            // Woken up, or the word changed before the wait ( -EAGAIN ): try again. Anything else,
+            // e.g. -EINVAL before 6.7, would fail again on every retry
+            if (result < 0 && result != -EAGAIN && result != -EINTR) panic("futex_wait", -result);
+            if (mutex.acquire_or_wait(service, this)) handle.resume();
+        }
+
+    private:
+        shared_async_mutex& mutex;
+        io_service& service;
+        std::coroutine_handle<> handle;
+    };
+
+    /** Lock the mutex
+     * @param service ring of the calling thread, which waits for the mutex if it's contended
+     * @return an awaitable resumed once the mutex is owned
+     */
+    [[nodiscard]]
+    lock_awaitable lock(io_service& service) noexcept {
+        return { *this, service };
+    }
+
+    bool try_lock() noexcept {
+        uint32_t expected = 0;
+        return word().compare_exchange_strong(expected, 1, std::memory_order_acquire, std::memory_order_relaxed);
+    }
+
+    /** Unlock the mutex, waking a waiter up if there are some
+     * @param service ring of the calling thread, which submits the wake-up ( IORING_OP_FUTEX_WAKE )
+     */
+    void unlock(io_service& service) noexcept {
+        if (word().fetch_sub(1, std::memory_order_release) != 1) {
+            word().store(0, std::memory_order_release);
+            (void) service.futex_wake(&state, 1, FUTEX_BITSET_MATCH_ANY, futex_flags, IOSQE_CQE_SKIP_SUCCESS);
+            // Right away: the ring may have nothing else to submit, or stop running before it does
+            service.submit();
+        }
+    }
+
+private:
+    static constexpr uint32_t futex_flags = FUTEX2_SIZE_U32 | FUTEX2_PRIVATE;
+
+    /** Take the mutex, marking it contended, or wait on the futex
+     * @return whether the mutex is taken
+     */
+    bool acquire_or_wait(io_service& service, resolver* waiter) noexcept {
+        if (word().exchange(2, std::memory_order_acquire) == 0) return true;
+        auto awaitable = service.futex_wait(&state, 2, FUTEX_BITSET_MATCH_ANY, futex_flags);
+        set_resolver(awaitable.sqe, waiter);
+        return false;
+    }
+
+    std::atomic_ref<uint32_t> word() noexcept {
+        return std::atomic_ref<uint32_t>(state);
+    }
+
+    alignas(std::atomic_ref<uint32_t>::required_alignment) uint32_t state = 0;
+};
+
+} // namespace uio
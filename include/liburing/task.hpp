@@ -7,10 +7,26 @@
 #include <utility>
 #include <coroutine>
 
+#include <liburing/frame_allocator.hpp>
+
 namespace uio {
 template <typename T, bool nothrow>
 struct task;
 
+namespace detail {
+/** Notified when a task finishes, in place of a waiter. Used by when_all / when_any */
+struct task_observer {
+    /** @return the coroutine to resume next */
+    virtual std::coroutine_handle<> on_done() noexcept = 0;
+
+protected:
+    ~task_observer() = default;
+};
+
+template <typename T, bool nothrow>
+struct task_child;
+} // namespace detail
+
 // only for internal usage
 template <typename T, bool nothrow>
 struct task_promise_base {
@@ -28,6 +44,8 @@ struct task_promise_base {
                         me_->waiter_.destroy();
                     }
                     std::coroutine_handle<task_promise_base>::from_promise(*me_).destroy();
+                } else if (me_->observer_) {
+                    return me_->observer_->on_done();
                 } else if (me_->waiter_) {
                     return me_->waiter_;
                 }
@@ -36,6 +54,14 @@ struct task_promise_base {
         };
         return Awaiter(this);
     }
+    /** Frames come from the allocator installed by set_frame_allocator */
+    static void* operator new(size_t size) {
+        return detail::allocate_frame(size);
+    }
+    static void operator delete(void* ptr, size_t size) noexcept {
+        detail::deallocate_frame(ptr, size);
+    }
+
     void unhandled_exception() {
         if constexpr (!nothrow) {
             if (__builtin_expect(result_.index() == 3, false)) return;
@@ -47,8 +73,10 @@ struct task_promise_base {
 
 protected:
     friend struct task<T, nothrow>;
+    friend struct detail::task_child<T, nothrow>;
     task_promise_base() = default;
     std::coroutine_handle<> waiter_;
+    detail::task_observer* observer_ = nullptr;
     std::variant<
         std::monostate,
         std::conditional_t<std::is_void_v<T>, std::monostate, T>,
@@ -83,6 +111,23 @@ struct task_promise<void, nothrow> final: task_promise_base<void, nothrow> {
     }
 };
 
+/**
+ * Return type of a detached coroutine that nobody awaits: it starts eagerly and destroys
+ * itself when done. Having no owner and no parent, it may be moved to another thread by
+ * `co_await runtime::schedule()`, which only accepts this kind of coroutine
+ * @note an exception escaping it calls std::terminate, there is nobody to catch it
+ */
+struct stealable final {
+    struct promise_type {
+        stealable get_return_object() noexcept { return {}; }
+        auto initial_suspend() noexcept { return std::suspend_never(); }
+        auto final_suspend() noexcept { return std::suspend_never(); }
+        void return_void() noexcept {}
+        void unhandled_exception() noexcept { std::terminate(); }
+        // Frames use the global allocator: a thread-local frame allocator may not get them back
+    };
+};
+
 /**
  * An awaitable object that returned by an async function
  * @tparam T value type holded by this task
@@ -107,6 +152,10 @@ struct task final {
         coro_.promise().waiter_ = caller;
     }
 
+    void await_suspend(std::coroutine_handle<stealable::promise_type> caller) noexcept {
+        coro_.promise().waiter_ = caller;
+    }
+
     T await_resume() const {
         return get_result();
     }
@@ -155,6 +204,7 @@ struct task final {
 
 private:
     friend struct task_promise_base<T, nothrow>;
+    friend struct detail::task_child<T, nothrow>;
     task(promise_type *p): coro_(handle_t::from_promise(*p)) {}
     handle_t coro_;
 };
@@ -0,0 +1,308 @@
+#pragma once
+
+#include <ctime>
+#include <chrono>
+#include <functional>
+#include <optional>
+#include <stop_token>
+
+#include <liburing/io_service.hpp>
+#include <liburing/timer_wheel.hpp>
+
+namespace uio {
+namespace detail {
+/**
+ * Timer wheel of a clock, driven by a single absolute kernel timeout armed
+ * for its next event ( IORING_TIMEOUT_ABS ). An earlier timer moves the pending
+ * kernel timeout instead of adding one ( IORING_TIMEOUT_UPDATE )
+ */
+struct timer_driver final: resolver {
+    static constexpr std::chrono::nanoseconds resolution = std::chrono::milliseconds(1);
+
+    timer_driver(io_service& service, clockid_t clock) noexcept
+        : service(service), clock(clock), wheel(now()) {}
+
+    /** Sleeps still pending are left unlinked, they never resume */
+    ~timer_driver() noexcept {
+        wheel.clear();
+    }
+
+    timer_driver(const timer_driver&) = delete;
+    timer_driver& operator =(const timer_driver&) = delete;
+
+    /** Current tick of the clock */
+    [[nodiscard]]
+    uint64_t now() const noexcept {
+        timespec ts;
+        clock_gettime(clock, &ts);
+        return uint64_t((std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec)) / resolution);
+    }
+
+    /** Tick of an absolute deadline on the clock, rounded up */
+    [[nodiscard]]
+    static uint64_t to_tick(std::chrono::nanoseconds deadline) noexcept {
+        if (deadline.count() <= 0) return 0;
+        return uint64_t((deadline + resolution - std::chrono::nanoseconds(1)) / resolution);
+    }
+
+    /** Add a node to the wheel
+     * @return false if it has expired already
+     */
+    bool add(timer_node& node) noexcept {
+        if (wheel.empty()) wheel.reset(now());
+        if (!wheel.add(node)) return false;
+        if (node.expires < armed) arm(node.expires);
+        return true;
+    }
+
+    void remove(timer_node& node) noexcept {
+        // The kernel timeout is left alone, it rearms for what's left when it fires
+        wheel.remove(node);
+    }
+
+    /** The kernel timeout fired ( -ETIME ) */
+    void resolve(int, uint32_t) noexcept override {
+        armed = timer_wheel::never;
+        wheel.advance(now());
+        if (const auto next = wheel.next_event(); next != timer_wheel::never && next < armed) arm(next);
+    }
+
+    void arm(uint64_t tick) noexcept {
+        const auto deadline = std::chrono::duration_cast<std::chrono::nanoseconds>(tick * resolution);
+        const auto secs = std::chrono::duration_cast<std::chrono::seconds>(deadline);
+        ts = { secs.count(), (deadline - secs).count() };
+
+        auto* sqe = service.io_uring_get_sqe_safe();
+        if (armed == timer_wheel::never) {
+            unsigned flags = IORING_TIMEOUT_ABS;
+            if (clock == CLOCK_BOOTTIME) flags |= IORING_TIMEOUT_BOOTTIME;
+            if (clock == CLOCK_REALTIME) flags |= IORING_TIMEOUT_REALTIME;
+            io_uring_prep_timeout(sqe, &ts, 0, flags);
+            set_resolver(sqe, this);
+        } else {
+            // If it has fired already, resolve() arms a new one anyway. The clock is the one of
+            // the pending timeout: an update taking clock flags fails with -EINVAL
+            io_uring_prep_timeout_update(sqe, &ts, to_user_data(this), IORING_TIMEOUT_ABS);
+            io_uring_sqe_set_flags(sqe, IOSQE_CQE_SKIP_SUCCESS);
+        }
+        armed = tick;
+    }
+
+    io_service& service;
+    const clockid_t clock;
+    timer_wheel wheel;
+    /** Read by the kernel when the timeout is submitted */
+    __kernel_timespec ts {};
+    /** Tick the kernel timeout is armed for */
+    uint64_t armed = timer_wheel::never;
+};
+
+inline void destroy(timer_driver* driver) noexcept {
+    delete driver;
+}
+
+/** Time since the epoch of a time_point, as a duration of the matching clock */
+template <typename Clock>
+inline std::chrono::nanoseconds since_epoch(std::chrono::time_point<Clock> tp) noexcept {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(tp.time_since_epoch());
+}
+} // namespace detail
+
+struct cancellable_sleep_awaitable;
+
+/** Awaitable of io_service::sleep_for / sleep_until */
+struct sleep_awaitable: private timer_node {
+    sleep_awaitable(detail::timer_driver& driver, uint64_t expires) noexcept: driver(driver) {
+        this->expires = expires;
+        this->expire = [](timer_node* self) noexcept {
+            static_cast<sleep_awaitable *>(self)->handle.resume();
+        };
+    }
+
+    /** Leave the wheel if the sleep is still pending, e.g. when its coroutine is destroyed */
+    ~sleep_awaitable() noexcept {
+        // The driver is gone along with its io_service once it has unlinked every node
+        if (timer_wheel::contains(*this)) driver.remove(*this);
+    }
+
+    sleep_awaitable(const sleep_awaitable&) = delete;
+    sleep_awaitable& operator =(const sleep_awaitable&) = delete;
+
+    bool await_ready() const noexcept { return false; }
+
+    bool await_suspend(std::coroutine_handle<> handle) noexcept {
+        this->handle = handle;
+        return driver.add(*this);
+    }
+
+    void await_resume() const noexcept {}
+
+    /** Stop sleeping when `token` is stopped
+     * @return an awaitable resolved to 0 once the sleep is over, -ECANCELED if it's canceled
+     * @warning stop the source on the thread running the io_service
+     */
+    cancellable_sleep_awaitable cancel_on(cancel_token token) noexcept;
+
+private:
+    detail::timer_driver& driver;
+    std::coroutine_handle<> handle;
+};
+
+/** Awaitable of sleep_awaitable::cancel_on */
+struct cancellable_sleep_awaitable: private timer_node {
+    cancellable_sleep_awaitable(detail::timer_driver& driver, uint64_t expires, cancel_token token) noexcept
+        : driver(driver), token(std::move(token)) {
+        this->expires = expires;
+        this->expire = [](timer_node* self) noexcept {
+            static_cast<cancellable_sleep_awaitable *>(self)->handle.resume();
+        };
+    }
+
+    ~cancellable_sleep_awaitable() noexcept {
+        if (timer_wheel::contains(*this)) driver.remove(*this);
+    }
+
+    cancellable_sleep_awaitable(const cancellable_sleep_awaitable&) = delete;
+    cancellable_sleep_awaitable& operator =(const cancellable_sleep_awaitable&) = delete;
+
+    bool await_ready() const noexcept { return false; }
+
+    bool await_suspend(std::coroutine_handle<> handle) noexcept {
+        this->handle = handle;
+        if (!driver.add(*this)) return false;
+        // Invoked immediately if stopped already
+        callback.emplace(std::move(token), canceler { this });
+        return true;
+    }
+
+    int await_resume() noexcept {
+        callback.reset();
+        return result;
+    }
+
+private:
+    struct canceler {
+        cancellable_sleep_awaitable* self;
+
+        void operator ()() noexcept {
+            self->cancel();
+        }
+    };
+
+    void cancel() noexcept {
+        // Expired already, it's being resumed
+        if (!timer_wheel::contains(*this)) return;
+        driver.remove(*this);
+        result = -ECANCELED;
+        // Resumed by the cqe loop rather than inside request_stop() or await_suspend()
+        driver.service.yield().set_callback([handle = handle](int) { handle.resume(); });
+    }
+
+    detail::timer_driver& driver;
+    cancel_token token;
+    std::optional<std::stop_callback<canceler>> callback;
+    std::coroutine_handle<> handle;
+    int result = 0;
+};
+
+inline cancellable_sleep_awaitable sleep_awaitable::cancel_on(cancel_token token) noexcept {
+    return cancellable_sleep_awaitable(driver, this->expires, std::move(token));
+}
+
+/**
+ * A reusable timer invoking a callback on the thread of its io_service, for
+ * things like idle timeouts of connections. Arming and canceling are O(1) and
+ * don't submit anything unless the timer becomes the earliest one of its clock
+ */
+class timer: private timer_node {
+public:
+    /**
+     * @param service io_service running the callback
+     * @param callback invoked when the timer expires
+     * @param clock CLOCK_MONOTONIC, CLOCK_BOOTTIME or CLOCK_REALTIME
+     */
+    timer(io_service& service, std::function<void ()> callback, clockid_t clock = CLOCK_MONOTONIC)
+        : driver(service.timers(clock)), callback(std::move(callback)) {
+        this->expire = [](timer_node* self) noexcept {
+            static_cast<timer *>(self)->callback();
+        };
+    }
+
+    /** Cancel the timer */
+    ~timer() noexcept {
+        cancel();
+    }
+
+    timer(const timer&) = delete;
+    timer& operator =(const timer&) = delete;
+
+    /** (Re)arm the timer to expire after `duration` */
+    void expires_after(std::chrono::nanoseconds duration) noexcept {
+        // The clock is somewhere in the current tick, start from the end of it
+        expires_at((driver.now() + 1) * detail::timer_driver::resolution + duration);
+    }
+
+    /** (Re)arm the timer to expire at an absolute deadline, since the epoch of its clock
+     * @note a deadline that has passed invokes the callback immediately
+     */
+    void expires_at(std::chrono::nanoseconds deadline) noexcept {
+        cancel();
+        this->expires = detail::timer_driver::to_tick(deadline);
+        if (!driver.add(*this)) callback();
+    }
+
+    /** (Re)arm the timer to expire at a time_point of steady_clock or system_clock */
+    template <typename Clock>
+    void expires_at(std::chrono::time_point<Clock> deadline) noexcept {
+        static_assert(std::is_same_v<Clock, std::chrono::steady_clock> || std::is_same_v<Clock, std::chrono::system_clock>);
+        assert(driver.clock == (std::is_same_v<Clock, std::chrono::steady_clock> ? CLOCK_MONOTONIC : CLOCK_REALTIME)
+            && "The time_point is not on the clock of the timer");
+        expires_at(detail::since_epoch(deadline));
+    }
+
+    /** Disarm the timer if it's armed */
+    void cancel() noexcept {
+        driver.remove(*this);
+    }
+
+    /** Whether the timer is armed and not expired yet */
+    [[nodiscard]]
+    bool armed() const noexcept {
+        return timer_wheel::contains(*this);
+    }
+
+private:
+    detail::timer_driver& driver;
+    std::function<void ()> callback;
+};
+
+inline detail::timer_driver& io_service::timers(clockid_t clock) {
+    unsigned index;
+    switch (clock) {
+    case CLOCK_MONOTONIC: index = 0; break;
+    case CLOCK_BOOTTIME: index = 1; break;
+    case CLOCK_REALTIME: index = 2; break;
+    default: panic("timers", EINVAL);
+    }
+    auto*& driver = timer_drivers[index];
+    if (!driver) driver = new detail::timer_driver(*this, clock);
+    return *driver;
+}
+
+inline sleep_awaitable io_service::sleep_for(
+    std::chrono::nanoseconds duration,
+    clockid_t clock
+) {
+    auto& driver = timers(clock);
+    return sleep_awaitable(driver, driver.now() + detail::timer_driver::to_tick(duration) + 1);
+}
+
+inline sleep_awaitable io_service::sleep_until(std::chrono::steady_clock::time_point deadline) {
+    return sleep_awaitable(timers(CLOCK_MONOTONIC), detail::timer_driver::to_tick(detail::since_epoch(deadline)));
+}
+
+inline sleep_awaitable io_service::sleep_until(std::chrono::system_clock::time_point deadline) {
+    return sleep_awaitable(timers(CLOCK_REALTIME), detail::timer_driver::to_tick(detail::since_epoch(deadline)));
+}
+
+} // namespace uio
@@ -0,0 +1,220 @@
+#pragma once
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <climits>
+#include <utility>
+
+namespace uio {
+/** Links of an intrusive circular list */
+struct timer_link {
+    timer_link* prev = nullptr;
+    timer_link* next = nullptr;
+};
+
+/** Entry of a timer_wheel, owned by its user */
+struct timer_node: private timer_link {
+    /** Invoked by the wheel when the node expires. It's unlinked already */
+    void (*expire)(timer_node* self) noexcept = nullptr;
+    /** Expiration, in ticks */
+    uint64_t expires = 0;
+
+private:
+    friend class timer_wheel;
+
+    static constexpr uint16_t unlinked = UINT16_MAX;
+    static constexpr uint16_t expiring = UINT16_MAX - 1;
+
+    /** level * slots + slot, or one of the values above */
+    uint16_t slot = unlinked;
+};
+
+/**
+ * Hierarchical timer wheel with O(1) add and remove
+ * Every level has 64 slots, each one 64 times as long as a slot of the level
+ * below. A node is stored in the lowest level where its expiration differs from
+ * the current tick, and moved down when the wheel reaches its slot. 11 levels
+ * cover every 64 bit tick, so nothing is ever clamped.
+ * Time is in ticks; the wheel doesn't read any clock.
+ */
+class timer_wheel {
+public:
+    static constexpr unsigned slot_bits = 6;
+    static constexpr unsigned slots = 1u << slot_bits;
+    static constexpr unsigned levels = (64 + slot_bits - 1) / slot_bits;
+    static constexpr uint64_t never = UINT64_MAX;
+
+    explicit timer_wheel(uint64_t now = 0) noexcept: current(now) {
+        for (auto& head : heads) head.prev = head.next = &head;
+    }
+
+    timer_wheel(const timer_wheel&) = delete;
+    timer_wheel& operator =(const timer_wheel&) = delete;
+
+    /** The last tick processed */
+    [[nodiscard]]
+    uint64_t now() const noexcept { return current; }
+
+    /** Number of nodes in the wheel */
+    [[nodiscard]]
+    size_t size() const noexcept { return count; }
+
+    [[nodiscard]]
+    bool empty() const noexcept { return count == 0; }
+
+    /** Restart an empty wheel at `now` */
+    void reset(uint64_t now) noexcept {
+        assert(empty());
+        current = now;
+    }
+
+    /** Add a node expiring at `node.expires`
+     * @return false if it has expired already, the node is not added then
+     */
+    bool add(timer_node& node) noexcept {
+        if (node.expires <= current) return false;
+        insert(node);
+        ++count;
+        return true;
+    }
+
+    /** Remove a node if it's in the wheel */
+    void remove(timer_node& node) noexcept {
+        if (node.slot == timer_node::unlinked) return;
+        unlink(node);
+        --count;
+    }
+
+    /** Unlink every node without expiring it */
+    void clear() noexcept {
+        for (auto& head : heads) {
+            while (head.next != &head) {
+                auto& node = node_of(std::exchange(head.next, head.next->next));
+                node.slot = timer_node::unlinked;
+            }
+            head.prev = &head;
+        }
+        bitmaps = {};
+        count = 0;
+    }
+
+    /** Whether a node is in the wheel */
+    [[nodiscard]]
+    static bool contains(const timer_node& node) noexcept {
+        return node.slot != timer_node::unlinked;
+    }
+
+    /** The earliest tick at which advance() has something to do, or `never` */
+    [[nodiscard]]
+    uint64_t next_event() const noexcept {
+        for (unsigned level = 0; level < levels; ++level) {
+            const unsigned shift = level * slot_bits;
+            const unsigned index = unsigned(current >> shift) & (slots - 1);
+            // Nodes of a level are always after the current slot of it
+            const uint64_t pending = index == slots - 1 ? 0 : bitmaps[level] & (~uint64_t(0) << (index + 1));
+            if (pending) {
+                const uint64_t base = shift + slot_bits >= 64 ? 0 : current >> (shift + slot_bits) << (shift + slot_bits);
+                return base + (uint64_t(__builtin_ctzll(pending)) << shift);
+            }
+        }
+        return never;
+    }
+
+    /** Expire every node up to `now`, in order of expiration */
+    void advance(uint64_t now) noexcept {
+        for (uint64_t tick; (tick = next_event()) <= now; ) {
+            current = tick;
+            process(tick);
+        }
+        if (now > current) current = now;
+    }
+
+private:
+    static timer_node& node_of(timer_link* link) noexcept {
+        return static_cast<timer_node &>(*link);
+    }
+
+    static timer_link& link_of(timer_node& node) noexcept {
+        return static_cast<timer_link &>(node);
+    }
+
+    static void push_back(timer_link& head, timer_link& link) noexcept {
+        link.prev = head.prev;
+        link.next = &head;
+        head.prev->next = &link;
+        head.prev = &link;
+    }
+
+    void insert(timer_node& node) noexcept {
+        const uint64_t diff = node.expires ^ current;
+        // A node expiring at the current tick goes to the current level 0 slot, which is about to be processed
+        const unsigned level = diff ? (63 - unsigned(__builtin_clzll(diff))) / slot_bits : 0;
+        const unsigned index = unsigned(node.expires >> (level * slot_bits)) & (slots - 1);
+        const unsigned slot = level * slots + index;
+
+        push_back(heads[slot], link_of(node));
+        node.slot = uint16_t(slot);
+        bitmaps[level] |= uint64_t(1) << index;
+    }
+
+    void unlink(timer_node& node) noexcept {
+        auto& link = link_of(node);
+        link.prev->next = link.next;
+        link.next->prev = link.prev;
+        if (node.slot != timer_node::expiring) {
+            auto& head = heads[node.slot];
+            if (head.next == &head) bitmaps[node.slot / slots] &= ~(uint64_t(1) << (node.slot % slots));
+        }
+        node.slot = timer_node::unlinked;
+    }
+
+    /** Move the list of a slot to `to`, so that callbacks may add or remove nodes while it's walked */
+    void take(unsigned slot, timer_link& to) noexcept {
+        auto& head = heads[slot];
+        to.prev = to.next = &to;
+        if (head.next == &head) return;
+
+        to.next = head.next;
+        to.prev = head.prev;
+        to.next->prev = &to;
+        to.prev->next = &to;
+        head.prev = head.next = &head;
+        bitmaps[slot / slots] &= ~(uint64_t(1) << (slot % slots));
+        for (auto* link = to.next; link != &to; link = link->next) node_of(link).slot = timer_node::expiring;
+    }
+
+    void process(uint64_t tick) noexcept {
+        // Move nodes of higher levels whose slot starts now down, highest first
+        for (unsigned level = levels - 1; level > 0; --level) {
+            const unsigned shift = level * slot_bits;
+            if (tick & ((uint64_t(1) << shift) - 1)) continue;
+
+            timer_link moving;
+            take(level * slots + (unsigned(tick >> shift) & (slots - 1)), moving);
+            while (moving.next != &moving) {
+                auto& node = node_of(moving.next);
+                moving.next = moving.next->next;
+                moving.next->prev = &moving;
+                insert(node);
+            }
+        }
+
+        timer_link expired;
+        take(unsigned(tick) & (slots - 1), expired);
+        while (expired.next != &expired) {
+            auto& node = node_of(expired.next);
+            unlink(node);
+            --count;
+            node.expire(&node);
+        }
+    }
+
+    std::array<timer_link, levels * slots> heads;
+    std::array<uint64_t, levels> bitmaps {};
+    uint64_t current;
+    size_t count = 0;
+};
+
+} // namespace uio
@@ -2,6 +2,9 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <string_view>
+#include <system_error>
+#include <coroutine>
+#include <cassert>
 #include <time.h>
 
 namespace uio {
@@ -81,8 +84,80 @@ template <bool nothrow>
 inline task<int> operator |(task<int, nothrow> tret, panic_on_err&& poe) {
     co_return (co_await tret) | std::move(poe);
 }
-inline task<int> operator |(sqe_awaitable tret, panic_on_err&& poe) {
-    co_return (co_await tret) | std::move(poe);
+
+/** Result of an operation that doesn't throw: cqe->res, either a value or -errno */
+struct io_result {
+    int res;
+
+    /** Whether the operation succeeded */
+    [[nodiscard]]
+    bool ok() const noexcept { return res >= 0; }
+    explicit operator bool() const noexcept { return ok(); }
+
+    /** Return value of a succeeded operation */
+    [[nodiscard]]
+    int value() const noexcept {
+        assert(ok());
+        return res;
+    }
+
+    /** Error of a failed operation, or an empty error_code
+     * @note a timeout reports its expiration as std::errc::stream_timeout ( ETIME )
+     */
+    [[nodiscard]]
+    std::error_code error() const noexcept {
+        return ok() ? std::error_code() : std::error_code(-res, std::generic_category());
+    }
+};
+
+/** `co_await op | as_result` resolves to an io_result instead of throwing */
+struct as_result_t {};
+inline constexpr as_result_t as_result {};
+
+inline io_result operator |(int ret, as_result_t) noexcept {
+    return { ret };
+}
+
+/**
+ * Awaitable that maps the result of another awaitable in `await_resume`,
+ * so the check costs neither a coroutine frame nor an extra resumption
+ * @note as with the awaitable itself, nothing is checked if it's not awaited
+ */
+template <typename Awaitable, typename Check>
+struct [[nodiscard]] checked_awaitable {
+    struct awaiter {
+        decltype(std::declval<Awaitable&>().operator co_await()) inner;
+        Check check;
+
+        bool await_ready() { return inner.await_ready(); }
+
+        template <typename Promise>
+        auto await_suspend(std::coroutine_handle<Promise> handle) {
+            return inner.await_suspend(handle);
+        }
+
+        auto await_resume() {
+            if constexpr (std::is_same_v<Check, as_result_t>) {
+                return io_result { inner.await_resume() };
+            } else {
+                return inner.await_resume() | std::move(check);
+            }
+        }
+    };
+
+    Awaitable inner;
+    Check check;
+
+    awaiter operator co_await() {
+        return { inner.operator co_await(), std::move(check) };
+    }
+};
+
+inline checked_awaitable<sqe_awaitable, panic_on_err> operator |(sqe_awaitable tret, panic_on_err&& poe) noexcept {
+    return { tret, std::move(poe) };
+}
+inline checked_awaitable<sqe_awaitable, as_result_t> operator |(sqe_awaitable tret, as_result_t) noexcept {
+    return { tret, {} };
 }
 
 } // namespace uio
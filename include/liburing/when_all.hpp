@@ -0,0 +1,335 @@
+#pragma once
+
+#include <cstdint>
+#include <tuple>
+#include <variant>
+#include <vector>
+
+#include <liburing/io_service.hpp>
+
+namespace uio {
+namespace detail {
+/** Bookkeeping shared by the children of a when_all / when_any */
+struct join_state {
+    static constexpr size_t none = SIZE_MAX;
+
+    explicit join_state(bool race) noexcept: race(race) {}
+
+    join_state(const join_state&) = delete;
+    join_state& operator =(const join_state&) = delete;
+
+    /** Hook a child up to this state, before the parent suspends */
+    template <typename Child, typename Awaitable>
+    void start(Child& child, Awaitable& awaitable, size_t index) noexcept {
+        child.state = this;
+        child.index = index;
+        if (child.start(awaitable)) {
+            ++pending;
+        } else if (race && winner == none) {
+            winner = index;
+        }
+    }
+
+    /** All children are started
+     * @return whether the parent has to suspend
+     */
+    bool started(std::coroutine_handle<> parent) noexcept {
+        this->parent = parent;
+        if (winner != none) cancel_losers();
+        return pending > 0;
+    }
+
+    /** A child is finished
+     * @return the parent if it was the last one, null otherwise
+     */
+    std::coroutine_handle<> child_done(size_t index) noexcept {
+        if (race && winner == none) {
+            winner = index;
+            cancel_losers();
+        }
+        return --pending == 0 ? parent : nullptr;
+    }
+
+    /** A child won't finish through this state anymore */
+    void dropped() noexcept {
+        --pending;
+    }
+
+    /** Cancel every child but the winner of a when_any */
+    virtual void cancel_losers() noexcept = 0;
+
+protected:
+    ~join_state() = default;
+
+    std::coroutine_handle<> parent;
+    /** Children whose completion is still waited for */
+    size_t pending = 0;
+    size_t winner = none;
+    /** when_any: the first finished child wins */
+    const bool race;
+};
+
+/** An sqe_awaitable of a when_all / when_any, resolved by its cqe */
+struct sqe_child final {
+    static constexpr resolver_kind kind = resolver_kind::join_child;
+
+    using value_type = int;
+
+    /** Terminate if the sqe of `op` left the SQ before being joined: a batch larger than the free
+     * SQ space submits its first sqes while the last ones are taken. They already run, with
+     * no user_data, writing into buffers of the caller, and their cqes are lost: nothing can
+     * be recovered, and throwing would unwind the caller while they still run */
+    static void check_queued(const sqe_awaitable& op) noexcept {
+        if (op.service && !queued(*op.service, op.sqe)) {
+            panic("when_all: sqe submitted before it's joined, reserve_sqes() first", E2BIG);
+        }
+    }
+
+    bool start(sqe_awaitable& op) noexcept {
+        service = op.service;
+        set_resolver(op.sqe, this);
+        return true;
+    }
+
+    void resolve(int result, uint32_t) noexcept {
+        this->result = result;
+        finished = true;
+        if (auto parent = state->child_done(index)) parent.resume();
+    }
+
+    /** Request cancellation. The cqe still comes, with -ECANCELED if it's canceled in time */
+    void cancel() noexcept {
+        if (finished) return;
+        assert(service && "The operation doesn't come from an io_service");
+        canceler { service, to_user_data(this) }();
+    }
+
+    int value() const noexcept { return result; }
+
+    /** Whether `sqe` is still in the SQ, not submitted yet */
+    static bool queued(io_service& service, const io_uring_sqe* sqe) noexcept {
+        const auto& sq = service.get_handle().sq;
+        const auto index = unsigned(sqe - sq.sqes);
+        return ((index - sq.sqe_head) & sq.ring_mask) < sq.sqe_tail - sq.sqe_head;
+    }
+
+    join_state* state = nullptr;
+    size_t index = 0;
+    bool finished = false;
+    io_service* service = nullptr;
+    int result = 0;
+};
+
+inline void resolve(sqe_child* child, int result, uint32_t flags) noexcept {
+    child->resolve(result, flags);
+}
+
+/** Check a child can be joined, before any of them is hooked up */
+template <typename Awaitable>
+void check_joinable(const Awaitable& awaitable) noexcept {
+    if constexpr (std::is_same_v<Awaitable, sqe_awaitable>) sqe_child::check_queued(awaitable);
+}
+
+/** A task of a when_all / when_any, observed through its promise */
+template <typename T, bool nothrow>
+struct task_child final: task_observer {
+    using value_type = std::conditional_t<std::is_void_v<T>, std::monostate, T>;
+
+    /** @return false if the task is done already */
+    bool start(task<T, nothrow>& awaited) noexcept {
+        this->awaited = &awaited;
+        if (awaited.done()) {
+            finished = true;
+            return false;
+        }
+        awaited.coro_.promise().observer_ = this;
+        return true;
+    }
+
+    std::coroutine_handle<> on_done() noexcept override {
+        awaited->coro_.promise().observer_ = nullptr;
+        finished = true;
+        auto parent = state->child_done(index);
+        return parent ? parent : std::noop_coroutine();
+    }
+
+    /** Tasks can't be canceled. Unhook it, so that it keeps running on its own */
+    void cancel() noexcept {
+        if (finished) return;
+        awaited->coro_.promise().observer_ = nullptr;
+        finished = true;
+        state->dropped();
+    }
+
+    value_type value() const {
+        if constexpr (std::is_void_v<T>) {
+            awaited->get_result();
+            return {};
+        } else {
+            return awaited->get_result();
+        }
+    }
+
+    join_state* state = nullptr;
+    size_t index = 0;
+    bool finished = false;
+    task<T, nothrow>* awaited = nullptr;
+};
+
+template <typename Awaitable>
+struct child_of {};
+
+template <>
+struct child_of<sqe_awaitable> {
+    using type = sqe_child;
+};
+
+template <typename T, bool nothrow>
+struct child_of<task<T, nothrow>> {
+    using type = task_child<T, nothrow>;
+};
+
+template <typename Awaitable>
+using child_t = typename child_of<std::remove_cvref_t<Awaitable>>::type;
+
+/** when_all / when_any over a fixed set of awaitables; children live in the awaiter */
+template <bool any, typename... Awaitables>
+class join_awaiter final: join_state {
+public:
+    explicit join_awaiter(Awaitables&&... awaitables)
+        : join_state(any), awaitables(std::forward<Awaitables>(awaitables)...) {}
+
+    bool await_ready() const noexcept { return false; }
+
+    bool await_suspend(std::coroutine_handle<> parent) noexcept {
+        [this]<size_t... I>(std::index_sequence<I...>) {
+            (check_joinable(std::get<I>(awaitables)), ...);
+            (start(std::get<I>(children), std::get<I>(awaitables), I), ...);
+        }(std::index_sequence_for<Awaitables...>());
+        return started(parent);
+    }
+
+    auto await_resume() {
+        if constexpr (any) {
+            using variant_t = std::variant<typename child_t<Awaitables>::value_type...>;
+            return [this]<size_t... I>(std::index_sequence<I...>) {
+                using getter_t = variant_t (*)(join_awaiter& self);
+                static constexpr getter_t getters[] = {
+                    [](join_awaiter& self) {
+                        return variant_t(std::in_place_index<I>, std::get<I>(self.children).value());
+                    }...
+                };
+                return std::pair<size_t, variant_t>(winner, getters[winner](*this));
+            }(std::index_sequence_for<Awaitables...>());
+        } else {
+            return std::apply([](auto&... children) {
+                return std::tuple<typename child_t<Awaitables>::value_type...> { children.value()... };
+            }, children);
+        }
+    }
+
+private:
+    void cancel_losers() noexcept override {
+        std::apply([](auto&... children) { (children.cancel(), ...); }, children);
+    }
+
+    /** Values for temporaries, references for lvalues */
+    std::tuple<Awaitables...> awaitables;
+    std::tuple<child_t<Awaitables>...> children;
+};
+
+/** when_all / when_any over a vector of awaitables */
+template <bool any, typename Awaitable>
+class join_range_awaiter final: join_state {
+public:
+    explicit join_range_awaiter(std::vector<Awaitable>& awaitables)
+        : join_state(any), awaitables(awaitables), children(awaitables.size()) {
+        assert((!any || !awaitables.empty()) && "when_any of nothing");
+    }
+
+    bool await_ready() const noexcept { return false; }
+
+    bool await_suspend(std::coroutine_handle<> parent) noexcept {
+        for (const auto& awaitable : awaitables) check_joinable(awaitable);
+        for (size_t i = 0; i < children.size(); ++i) start(children[i], awaitables[i], i);
+        return started(parent);
+    }
+
+    auto await_resume() {
+        if constexpr (any) {
+            return std::pair<size_t, value_type>(winner, children[winner].value());
+        } else {
+            std::vector<value_type> result;
+            result.reserve(children.size());
+            for (auto& child : children) result.push_back(child.value());
+            return result;
+        }
+    }
+
+private:
+    using value_type = typename child_t<Awaitable>::value_type;
+
+    void cancel_losers() noexcept override {
+        for (auto& child : children) child.cancel();
+    }
+
+    std::vector<Awaitable>& awaitables;
+    std::vector<child_t<Awaitable>> children;
+};
+} // namespace detail
+
+/** An sqe_awaitable or a task */
+template <typename Awaitable>
+concept joinable = requires { typename detail::child_t<Awaitable>; };
+
+/**
+ * Await all of sqe_awaitables and tasks at once, resuming the caller once when
+ * the last one finishes. The sqes are submitted in the same batch, and nothing
+ * is allocated: the children are tracked inside the returned awaiter
+ * @note every sqe_awaitable must be passed before anything else is awaited, and its cqe must not be skipped
+ *       All of them must still be in the SQ when awaited: `co_await service.reserve_sqes(n)` before taking
+ *       them. An sqe submitted before it's joined terminates the program, since it already runs unobserved
+ * @return an awaitable resolved to a tuple of results: int for sqe_awaitable, T for task<T>, std::monostate for task<>
+ */
+template <joinable... Awaitables>
+[[nodiscard]]
+inline auto when_all(Awaitables&&... awaitables) {
+    return detail::join_awaiter<false, Awaitables...>(std::forward<Awaitables>(awaitables)...);
+}
+
+/** Range form of when_all, the vector must outlive the await
+ * @note `co_await service.reserve_sqes(n)` before taking more sqes than the SQ has free, or the program is terminated
+ * @return an awaitable resolved to a vector of results
+ */
+template <joinable Awaitable>
+[[nodiscard]]
+inline auto when_all(std::vector<Awaitable>& awaitables) {
+    return detail::join_range_awaiter<false, Awaitable>(awaitables);
+}
+
+/**
+ * Await the first finished one of sqe_awaitables and tasks. Pending operations
+ * of the losers are canceled ( IORING_OP_ASYNC_CANCEL ) and the caller is resumed
+ * once their cqes arrive. Tasks can't be canceled, losing ones are left running
+ * @note every sqe_awaitable must be passed before anything else is awaited, and its cqe must not be skipped
+ *       Like when_all, they must still be in the SQ: `co_await service.reserve_sqes(n)` before taking them
+ * @return an awaitable resolved to a pair of the index of the winner and a variant holding its result
+ */
+template <joinable... Awaitables>
+[[nodiscard]]
+inline auto when_any(Awaitables&&... awaitables) {
+    static_assert(sizeof...(Awaitables) > 0, "when_any of nothing");
+    return detail::join_awaiter<true, Awaitables...>(std::forward<Awaitables>(awaitables)...);
+}
+
+/** Range form of when_any, the vector must outlive the await and must not be empty
+ * @note `co_await service.reserve_sqes(n)` before taking more sqes than the SQ has free, or the program is terminated
+ * @return an awaitable resolved to a pair of the index of the winner and its result
+ */
+template <joinable Awaitable>
+[[nodiscard]]
+inline auto when_any(std::vector<Awaitable>& awaitables) {
+    return detail::join_range_awaiter<true, Awaitable>(awaitables);
+}
+
+} // namespace uio
@@ -0,0 +1,189 @@
+#pragma once
+
+#include <utility>
+#include <coroutine>
+#include <sys/socket.h>
+#include <liburing.h>   // http://git.kernel.dk/liburing
+
+#include <liburing/io_service.hpp>
+
+namespace uio {
+/**
+ * Resolver of a zero-copy send. The kernel posts up to two cqes for it: the
+ * result, flagged with IORING_CQE_F_MORE if a notification follows, and the
+ * notification (IORING_CQE_F_NOTIF) telling the buffer may be reused.
+ * Shared by the zc_send object and the kernel, so it outlives the object until
+ * the last cqe arrives.
+ */
+struct zc_resolver final {
+    static constexpr resolver_kind kind = resolver_kind::zero_copy;
+
+    void resolve(int result, uint32_t flags) noexcept {
+        std::coroutine_handle<> first, second;
+
+        if (flags & IORING_CQE_F_NOTIF) {
+            notif_pending = false;
+            lease.release();
+            first = std::exchange(notif_waiter, nullptr);
+        } else {
+            this->result = result;
+            done = true;
+            notif_pending = flags & IORING_CQE_F_MORE;
+            // No notification follows if nothing was sent
+            if (!notif_pending) lease.release();
+            first = std::exchange(waiter, nullptr);
+            // Nor are waiters of the notification left waiting then
+            if (!notif_pending) second = std::exchange(notif_waiter, nullptr);
+        }
+
+        // The resumed coroutines may destroy the zc_send object, or have done so already:
+        // this resolver is only deleted once both ran, the last cqe being in
+        resuming = true;
+        if (first) first.resume();
+        if (second) second.resume();
+        resuming = false;
+        if (detached && finished()) delete this;
+    }
+
+    /** Called when the zc_send object goes away */
+    void detach() noexcept {
+        if (finished() && !resuming) {
+            delete this;
+        } else {
+            detached = true;
+        }
+    }
+
+    bool finished() const noexcept { return done && !notif_pending; }
+
+    std::coroutine_handle<> waiter;
+    std::coroutine_handle<> notif_waiter;
+    /** Buffer sent, given back to its ring on notification (optional) */
+    buffer_lease lease;
+    int result = 0;
+    bool done = false;
+    bool notif_pending = false;
+    bool detached = false;
+    /** Waiters are being resumed, see resolve() */
+    bool resuming = false;
+};
+
+/**
+ * A pending zero-copy send
+ * `co_await op` resumes on the result of the send. `co_await op.notified()` resumes
+ * once the kernel no longer references the buffer.
+ * The object may be dropped without awaiting; the request stays alive and the
+ * owned buffer_lease, if any, is released on notification.
+ */
+class zc_send {
+    friend class io_service;
+
+public:
+    explicit zc_send(zc_resolver* state) noexcept: state(state) {}
+
+    zc_send(const zc_send&) = delete;
+    zc_send& operator =(const zc_send&) = delete;
+
+    zc_send(zc_send&& other) noexcept
+        : state(std::exchange(other.state, nullptr)) {}
+
+    zc_send& operator =(zc_send&& other) noexcept {
+        if (this != &other) {
+            if (state) state->detach();
+            state = std::exchange(other.state, nullptr);
+        }
+        return *this;
+    }
+
+    ~zc_send() noexcept {
+        if (state) state->detach();
+    }
+
+    /** Wait for the result of the send
+     * @return an awaitable resolved to bytes sent or -errno
+     */
+    auto operator co_await() const noexcept {
+        struct await_result {
+            zc_resolver* state;
+
+            bool await_ready() const noexcept { return state->done; }
+            void await_suspend(std::coroutine_handle<> handle) noexcept { state->waiter = handle; }
+            int await_resume() const noexcept { return state->result; }
+        };
+
+        return await_result { state };
+    }
+
+    /** Wait until the buffer may be reused or freed */
+    auto notified() const noexcept {
+        struct await_notif {
+            zc_resolver* state;
+
+            bool await_ready() const noexcept { return state->finished(); }
+            void await_suspend(std::coroutine_handle<> handle) noexcept { state->notif_waiter = handle; }
+            constexpr void await_resume() const noexcept {}
+        };
+
+        return await_notif { state };
+    }
+
+    /** Whether the buffer may be reused or freed */
+    [[nodiscard]]
+    bool is_notified() const noexcept { return state->finished(); }
+
+private:
+    zc_resolver* state;
+};
+
+inline void detail::resolve(zc_resolver* resolver, int result, uint32_t flags) noexcept {
+    resolver->resolve(result, flags);
+}
+
+inline checked_awaitable<const zc_send&, panic_on_err> operator |(const zc_send& tret, panic_on_err&& poe) noexcept {
+    return { tret, std::move(poe) };
+}
+inline checked_awaitable<const zc_send&, as_result_t> operator |(const zc_send& tret, as_result_t) noexcept {
+    return { tret, {} };
+}
+
+inline zc_send io_service::send_zc(
+    int sockfd,
+    const void* buf,
+    unsigned nbytes,
+    uint32_t flags,
+    uint8_t iflags
+) {
+    auto* state = new zc_resolver();
+    auto* sqe = io_uring_get_sqe_safe();
+    io_uring_prep_send_zc(sqe, sockfd, buf, nbytes, int(flags), 0);
+    io_uring_sqe_set_flags(sqe, iflags);
+    set_resolver(sqe, state);
+    return zc_send(state);
+}
+
+inline zc_send io_service::send_zc(
+    int sockfd,
+    buffer_lease&& lease,
+    uint32_t flags,
+    uint8_t iflags
+) {
+    auto result = send_zc(sockfd, lease.data(), lease.size(), flags, iflags);
+    result.state->lease = std::move(lease);
+    return result;
+}
+
+inline zc_send io_service::sendmsg_zc(
+    int sockfd,
+    const msghdr* msg,
+    uint32_t flags,
+    uint8_t iflags
+) {
+    auto* state = new zc_resolver();
+    auto* sqe = io_uring_get_sqe_safe();
+    io_uring_prep_sendmsg_zc(sqe, sockfd, msg, flags);
+    io_uring_sqe_set_flags(sqe, iflags);
+    set_resolver(sqe, state);
+    return zc_send(state);
+}
+
+} // namespace uio
@@ -0,0 +1,86 @@
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <fmt/core.h>
+
+#include <liburing/acceptor.hpp>
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+
+std::atomic<int> served[2];
+
+int main() {
+    using uio::io_service;
+    using uio::runtime;
+    using uio::task;
+    using uio::panic;
+    using uio::panic_on_err;
+
+    runtime rt(2, 16, 0, 8);
+    io_service service;
+    service.register_files_sparse(8);
+    uio::acceptor acceptor(service, rt);
+
+    int listener = socket(AF_INET, SOCK_STREAM, 0) | panic_on_err("socket creation", true);
+    sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = 0,
+        .sin_addr = { htonl(INADDR_LOOPBACK) },
+        .sin_zero = {},
+    };
+    socklen_t addrlen = sizeof (addr);
+    if (bind(listener, reinterpret_cast<sockaddr *>(&addr), addrlen)) panic("socket binding", errno);
+    if (getsockname(listener, reinterpret_cast<sockaddr *>(&addr), &addrlen)) panic("getsockname", errno);
+    if (listen(listener, 16)) panic("listen", errno);
+
+    auto server = acceptor.serve(listener, [&rt](io_service& service, int fd) -> task<> {
+        ++served[rt.current_core()];
+        char c;
+        // The socket only exists in the file table of the worker
+        while (co_await service.recv(fd, &c, 1, 0, IOSQE_FIXED_FILE) == 1) {
+            co_await service.send(fd, &c, 1, 0, IOSQE_FIXED_FILE);
+        }
+    });
+
+    service.run([&] (task<int>& server) -> task<> {
+        // Keep connections open, so that the second one goes to the idle worker
+        int clients[3];
+        for (int& client : clients) {
+            client = socket(AF_INET, SOCK_STREAM, 0) | panic_on_err("socket creation", true);
+            co_await service.connect(client, reinterpret_cast<sockaddr *>(&addr), addrlen) | panic_on_err("connect", false);
+            char c = 'x';
+            co_await service.send(client, &c, 1, 0) | panic_on_err("send", false);
+            if (co_await service.recv(client, &c, 1, 0) != 1 || c != 'x') throw std::runtime_error("Bad echo");
+            if (&client == &clients[1] && (acceptor.load(0) != 1 || acceptor.load(1) != 1)) {
+                throw std::runtime_error("Connections are not spread");
+            }
+        }
+        if (acceptor.load(0) + acceptor.load(1) != 3) throw std::runtime_error("Bad load");
+
+        for (int client : clients) co_await service.close(client);
+        // Workers close their slots once they see EOF
+        auto ts = uio::dur2ts(std::chrono::milliseconds(1));
+        while (acceptor.load(0) + acceptor.load(1) > 0) co_await service.timeout(&ts);
+
+        shutdown(listener, SHUT_RDWR);
+        int res = co_await server;
+        fmt::print("Acceptor stopped: {}\n", res);
+    }(server));
+
+    rt.stop();
+    rt.run_until_stopped();
+    close(listener);
+
+    // Nothing is sent to the rings of a stopped runtime
+    int refused = 0;
+    service.run([&] () -> task<> {
+        int slot = co_await service.socket_direct(AF_INET, SOCK_STREAM, 0) | panic_on_err("socket_direct", false);
+        rt.send_file(service, 0, unsigned(slot), uio::callback_resolver::create([&](int result) { refused = result; }));
+        co_await service.yield();
+        // Closed by send_file anyway
+        if (co_await service.close_direct(unsigned(slot)) != -EBADF) throw std::runtime_error("Slot left open");
+    }());
+    if (refused != -ECANCELED) throw std::runtime_error("File sent after stop");
+    fmt::print("Served {} and {} connections\n", served[0].load(), served[1].load());
+    if (served[0] + served[1] != 3 || !served[0] || !served[1]) throw std::runtime_error("Unexpected counters");
+}
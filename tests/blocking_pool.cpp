@@ -0,0 +1,71 @@
+#include <fmt/core.h>
+
+#include <liburing/blocking_pool.hpp>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+int main() {
+    using uio::io_service;
+    using uio::task;
+    using namespace std::literals;
+
+    uio::blocking_pool pool(4);
+    io_service service;
+
+    service.run([] (io_service& service, uio::blocking_pool& pool) -> task<> {
+        const auto caller = std::this_thread::get_id();
+
+        // Results are moved back, and the caller is resumed on its own thread
+        auto worker = co_await pool.invoke(service, [] { return std::this_thread::get_id(); });
+        auto message = co_await pool.invoke(service, [] { return std::make_unique<std::string>("blocking"); });
+        if (worker == caller || std::this_thread::get_id() != caller || *message != "blocking") throw std::runtime_error("Bad result");
+
+        // Exceptions are rethrown in the caller
+        try {
+            co_await pool.invoke(service, [] { throw std::runtime_error("thrown"); });
+            throw std::logic_error("Not rethrown");
+        } catch (const std::runtime_error& e) {
+            if (e.what() != "thrown"sv) throw;
+        }
+
+        // The ring keeps going while the calls block
+        auto start = std::chrono::steady_clock::now();
+        std::vector<task<int>> calls;
+        for (int i = 0; i < 4; ++i) {
+            calls.push_back([] (io_service& service, uio::blocking_pool& pool, int i) -> task<int> {
+                co_return co_await pool.invoke(service, [i] {
+                    std::this_thread::sleep_for(50ms);
+                    return i;
+                });
+            }(service, pool, i));
+        }
+        int yields = 0;
+        while (!calls.back().done()) {
+            co_await service.yield();
+            ++yields;
+        }
+        auto results = co_await uio::when_all(calls);
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        fmt::print("4 calls of 50ms in {}ms, {} yields meanwhile\n", elapsed / 1ms, yields);
+        for (int i = 0; i < 4; ++i) {
+            if (results[i] != i) throw std::runtime_error("Bad results");
+        }
+        if (yields == 0 || elapsed >= 150ms) throw std::runtime_error("Not concurrent");
+
+        // Many short calls
+        std::vector<task<int>> many;
+        for (int i = 0; i < 1000; ++i) {
+            many.push_back([] (io_service& service, uio::blocking_pool& pool, int i) -> task<int> {
+                co_return co_await pool.invoke(service, [i] () noexcept { return i * 2; });
+            }(service, pool, i));
+        }
+        auto sums = co_await uio::when_all(many);
+        for (int i = 0; i < 1000; ++i) {
+            if (sums[i] != i * 2) throw std::runtime_error("Bad many");
+        }
+    }(service, pool));
+}
@@ -0,0 +1,41 @@
+#include <fmt/core.h>
+
+#include <liburing/io_service.hpp>
+#include <string_view>
+
+int main() {
+    using uio::io_service;
+    using uio::buffer_ring;
+    using uio::task;
+
+    io_service service;
+    buffer_ring buffers(service, 1, 4, 64);
+
+    std::array<int, 2> p;
+    pipe(p.data()) | uio::panic_on_err("Unable to open pipe", true);
+
+    service.run([&] () -> task<> {
+        std::string_view msg = "provided buffer";
+
+        for (int i = 0; i < 10; i++) {
+            co_await service.write(p[1], msg.data(), msg.size(), 0)
+                | uio::panic_on_err("Unable to write to pipe", false);
+
+            auto buf = co_await service.read(p[0], buffers, 0);
+            if (buf.result() < 0) uio::panic("read with buffer select", -buf.result());
+            if (!buf) throw std::runtime_error("No buffer was picked");
+
+            auto recieved = std::string_view(buf.data(), buf.size());
+            fmt::print("Recieved {} in buffer {}\n", recieved, buf.bid());
+            if (recieved != msg) throw std::runtime_error("Unexpected message");
+            if (buffers.available() != 3) throw std::runtime_error("Lease is not taken from the ring");
+        }
+        // Every lease is given back when destructed
+        if (buffers.available() != 4) throw std::runtime_error("Lease is not given back to the ring");
+
+        co_await service.close(p[1]) | uio::panic_on_err("Unable to close write end", false);
+        auto eof = co_await service.read(p[0], buffers, 0);
+        if (eof.result() != 0) throw std::runtime_error("Pipe not at EOF like expected");
+        co_await service.close(p[0]) | uio::panic_on_err("Unable to close read end", false);
+    }());
+}
@@ -0,0 +1,56 @@
+#include <sys/socket.h>
+#include <fmt/core.h>
+
+#include <liburing/io_service.hpp>
+#include <chrono>
+#include <stdexcept>
+
+int main() {
+    using uio::io_service;
+    using uio::task;
+    using uio::panic_on_err;
+
+    io_service service;
+
+    // Nothing is ever sent to these sockets
+    int sv[2];
+    socketpair(AF_UNIX, SOCK_STREAM, 0, sv) | panic_on_err("socketpair", true);
+
+    service.run([&] () -> task<> {
+        char c;
+        uio::stop_source source;
+
+        // Stopped while the recv is pending
+        [](io_service& service, uio::stop_source& source) -> task<> {
+            auto ts = uio::dur2ts(std::chrono::milliseconds(10));
+            co_await service.timeout(&ts);
+            source.request_stop();
+        }(service, source);
+        int res = co_await service.recv(sv[0], &c, 1, 0).cancel_on(source.get_token());
+        fmt::print("Canceled pending recv: {}\n", res);
+        if (res != -ECANCELED) throw std::runtime_error("Not canceled");
+
+        // Stopped before the recv is awaited
+        res = co_await service.recv(sv[0], &c, 1, 0).cancel_on(source.get_token());
+        fmt::print("Canceled stopped recv: {}\n", res);
+        if (res != -ECANCELED) throw std::runtime_error("Not canceled");
+
+        // Never stopped
+        uio::stop_source unused;
+        service.send(sv[1], "x", 1, 0);
+        res = co_await service.recv(sv[0], &c, 1, 0).cancel_on(unused.get_token());
+        if (res != 1) throw std::runtime_error("Unexpected result");
+
+        // Keyed on the fd
+        [](io_service& service, int fd) -> task<> {
+            co_await service.yield();
+            int n = co_await service.cancel_fd(fd, IORING_ASYNC_CANCEL_ALL);
+            fmt::print("cancel_fd canceled {} request(s)\n", n);
+        }(service, sv[0]);
+        res = co_await service.recv(sv[0], &c, 1, 0);
+        if (res != -ECANCELED) throw std::runtime_error("Not canceled by fd");
+    }());
+
+    close(sv[0]);
+    close(sv[1]);
+}
@@ -0,0 +1,71 @@
+#include <fmt/core.h>
+
+#include <liburing/channel.hpp>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+int main() {
+    using uio::io_service;
+    using uio::task;
+
+    {
+        // Same ring: the consumer parks on an empty channel, the producer on a full one
+        io_service service;
+        uio::channel<std::unique_ptr<int>> ch(2);
+        service.run([] (io_service& service, uio::channel<std::unique_ptr<int>>& ch) -> task<> {
+            if (ch.try_recv(service)) throw std::runtime_error("Not empty");
+            auto one = std::make_unique<int>(1);
+            if (!ch.try_send(service, std::move(one)) || one) throw std::runtime_error("try_send failed");
+
+            auto producer = [] (io_service& service, uio::channel<std::unique_ptr<int>>& ch) -> task<> {
+                for (int i = 2; i <= 10; ++i) co_await ch.send(service, std::make_unique<int>(i));
+            }(service, ch);
+            for (int i = 1; i <= 10; ++i) {
+                auto value = co_await ch.recv(service);
+                if (*value != i) throw std::runtime_error("Out of order");
+            }
+            co_await producer;
+
+            // Full: try_send leaves the value alone
+            auto a = std::make_unique<int>(0), b = std::make_unique<int>(0), c = std::make_unique<int>(0);
+            if (!ch.try_send(service, std::move(a)) || !ch.try_send(service, std::move(b))) throw std::runtime_error("Not room");
+            if (ch.try_send(service, std::move(c)) || !c) throw std::runtime_error("Not full");
+            while (ch.try_recv(service)) {}
+        }(service, ch));
+    }
+
+    {
+        // Producers on other threads, a small capacity so that both sides park often
+        enum { PRODUCERS = 3, COROUTINES = 4, VALUES = 20000 };
+        uio::channel<int> ch(16);
+        std::vector<std::thread> threads;
+        for (int t = 0; t < PRODUCERS; ++t) {
+            threads.emplace_back([&ch] {
+                io_service service;
+                service.run([] (io_service& service, uio::channel<int>& ch) -> task<> {
+                    std::vector<task<>> tasks;
+                    for (int c = 0; c < COROUTINES; ++c) {
+                        tasks.push_back([] (io_service& service, uio::channel<int>& ch) -> task<> {
+                            for (int i = 1; i <= VALUES; ++i) co_await ch.send(service, i);
+                        }(service, ch));
+                    }
+                    co_await uio::when_all(tasks);
+                }(service, ch));
+            });
+        }
+
+        io_service service;
+        unsigned long sum = service.run([] (io_service& service, uio::channel<int>& ch) -> task<unsigned long> {
+            unsigned long sum = 0;
+            for (int i = 0; i < PRODUCERS * COROUTINES * VALUES; ++i) sum += co_await ch.recv(service);
+            co_return sum;
+        }(service, ch));
+        for (auto& thread : threads) thread.join();
+
+        const unsigned long expected = PRODUCERS * COROUTINES * (VALUES * (VALUES + 1UL) / 2);
+        fmt::print("received {} of {}, io_uring_enter {}\n", sum, expected, service.syscall_count());
+        if (sum != expected) throw std::runtime_error("Lost values");
+    }
+}
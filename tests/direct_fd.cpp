@@ -0,0 +1,62 @@
+#include <fmt/core.h>
+
+#include <liburing/io_service.hpp>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+int main() {
+    using uio::io_service;
+    using uio::task;
+    using uio::panic_on_err;
+
+    io_service sender, receiver;
+    sender.register_files_sparse(4);
+    receiver.register_files_sparse(4);
+
+    char path[] = "/tmp/uio_direct_fd_XXXXXX";
+    close(mkstemp(path));
+
+    // Slot the received file lands in, posted as a cqe to the receiving ring
+    uio::deferred_resolver installed;
+
+    sender.run([&] () -> task<> {
+        // Into a given slot, then into one picked by the kernel
+        if (co_await sender.openat_direct(AT_FDCWD, path, O_RDWR, 0, 1) != 0) throw std::runtime_error("openat_direct");
+        co_await sender.write(1, "direct", 6, 0, IOSQE_FIXED_FILE) | panic_on_err("write", false);
+        int socket = co_await sender.socket_direct(AF_UNIX, SOCK_STREAM, 0) | panic_on_err("socket_direct", false);
+        if (socket == 1) throw std::runtime_error("Slot in use handed out");
+
+        if (co_await sender.openat_direct(AT_FDCWD, "/nonexistent/uio", O_RDONLY, 0) != -ENOENT) {
+            throw std::runtime_error("Opened nothing");
+        }
+
+        // By ring fd, then by ring. The sent files stay in the table of the sender
+        if (co_await sender.send_fd(receiver.get_handle().ring_fd, 1, IORING_FILE_INDEX_ALLOC, uio::to_user_data(&installed)) != 0) {
+            throw std::runtime_error("send_fd");
+        }
+        if (co_await sender.send_fd(receiver, unsigned(socket), 3) != 0) throw std::runtime_error("send_fd to a slot");
+
+        if (co_await sender.close_direct(1) != 0 || co_await sender.close_direct(unsigned(socket)) != 0) {
+            throw std::runtime_error("close_direct");
+        }
+        if (co_await sender.close_direct(1) != -EBADF) throw std::runtime_error("Closed twice");
+    }());
+
+    receiver.run([&] () -> task<> {
+        while (!installed.result) co_await receiver.yield();
+        const int slot = *installed.result | panic_on_err("received file", false);
+
+        // Still open here, though closed in the sender
+        char buf[6];
+        if (co_await receiver.read(slot, buf, 6, 0, IOSQE_FIXED_FILE) != 6 || memcmp(buf, "direct", 6)) {
+            throw std::runtime_error("Bad read");
+        }
+        if (co_await receiver.close_direct(unsigned(slot)) != 0 || co_await receiver.close_direct(3) != 0) {
+            throw std::runtime_error("Received files missing");
+        }
+        fmt::print("Received the file into slot {}\n", slot);
+    }());
+
+    unlink(path);
+}
@@ -0,0 +1,92 @@
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <fmt/core.h>
+
+#include <liburing/io_service.hpp>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+int main() {
+    using uio::io_service;
+    using uio::task;
+    using uio::panic;
+    using uio::panic_on_err;
+
+    io_service service;
+    // Slots 0 and 1 are handed out by the table, 2 and 3 by the kernel
+    uio::file_table files(service, 4, 2);
+
+    int listener = socket(AF_INET, SOCK_STREAM, 0) | panic_on_err("socket creation", true);
+    sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = 0,
+        .sin_addr = { htonl(INADDR_LOOPBACK) },
+        .sin_zero = {},
+    };
+    socklen_t addrlen = sizeof (addr);
+    if (bind(listener, reinterpret_cast<sockaddr *>(&addr), addrlen)) panic("socket binding", errno);
+    if (getsockname(listener, reinterpret_cast<sockaddr *>(&addr), &addrlen)) panic("getsockname", errno);
+    if (listen(listener, 4)) panic("listen", errno);
+
+    service.run([&] () -> task<> {
+        char path[] = "/tmp/uio_file_table_XXXXXX";
+        close(mkstemp(path));
+
+        {
+            auto file = co_await files.openat(AT_FDCWD, path, O_RDWR, 0);
+            if (file.index() != 0) throw std::runtime_error("Unexpected slot");
+            co_await service.write(file, "hello", 5, 0) | panic_on_err("write", false);
+            char buf[5];
+            if (co_await service.read(file, buf, 5, 0) != 5 || memcmp(buf, "hello", 5)) throw std::runtime_error("Bad read");
+
+            auto missing = co_await files.openat(AT_FDCWD, "/nonexistent/uio", O_RDONLY, 0);
+            if (missing || missing.index() != -ENOENT) throw std::runtime_error("Opened nothing");
+
+            // Direct socket connected to an accept into a slot picked by the kernel
+            auto client = co_await files.socket(AF_INET, SOCK_STREAM, 0);
+            if (client.index() != 1) throw std::runtime_error("Failed socket");
+            service.connect(client, reinterpret_cast<sockaddr *>(&addr), addrlen);
+            int slot = co_await service.accept_direct(listener, nullptr, nullptr) | panic_on_err("accept_direct", false);
+            if (slot < 2) throw std::runtime_error("Kernel slot out of range");
+            auto server = files.adopt(unsigned(slot));
+
+            co_await service.send(client, "x", 1, 0) | panic_on_err("send", false);
+            if (co_await service.recv(server, buf, 1, 0) != 1 || buf[0] != 'x') throw std::runtime_error("Bad recv");
+
+            auto full = co_await files.socket(AF_INET, SOCK_STREAM, 0);
+            if (full.index() != -ENFILE) throw std::runtime_error("Table is not full");
+            fmt::print("{} slots in use\n", files.size());
+        }
+
+        // Closed slots are handed out again once their close completes
+        co_await service.yield();
+        if (files.size() != 0) throw std::runtime_error("Leaked slots");
+        auto again = co_await files.openat(AT_FDCWD, path, O_RDONLY, 0);
+        char c;
+        if (again.index() != 0 || co_await service.read(again, &c, 1, 0) != 1 || c != 'h') throw std::runtime_error("Bad reuse");
+        unlink(path);
+
+        // A file installed right after a reset isn't closed by the pending close
+        int sv[2];
+        socketpair(AF_UNIX, SOCK_STREAM, 0, sv) | panic_on_err("socketpair", true);
+        again.reset();
+        auto installed = files.install(sv[0]);
+        close(sv[0]);
+        co_await service.send(sv[1], "y", 1, 0) | panic_on_err("send", false);
+        if (co_await service.recv(installed, &c, 1, 0) != 1 || c != 'y') throw std::runtime_error("Installed file closed");
+        close(sv[1]);
+    }());
+
+    // A table destroyed while a close is in flight, which completes afterwards
+    io_service other;
+    other.run([&] () -> task<> {
+        {
+            uio::file_table table(other, 1);
+            auto fd = table.install(listener);
+        }
+        co_await other.yield();
+    }());
+
+    close(listener);
+}
@@ -0,0 +1,61 @@
+#include <fmt/core.h>
+
+#include <liburing/io_service.hpp>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+int main() {
+    using uio::io_service;
+    using uio::task;
+    using uio::panic_on_err;
+
+    io_service service;
+    // Regions of 256KiB, at most 3 of them
+    uio::fixed_buffer_pool pool(service, 256 * 1024, 3);
+
+    service.run([&] () -> task<> {
+        char path[] = "/tmp/uio_fixed_buffer_pool_XXXXXX";
+        int fd = mkstemp(path);
+        unlink(path);
+
+        auto small = pool.acquire(100);
+        auto large = pool.acquire(100 * 1024);
+        if (small.size() != 4096 || large.size() != 128 * 1024) throw std::runtime_error("Bad size class");
+
+        memset(small.data(), 'a', 100);
+        co_await service.write_fixed(fd, small, 100, 0) | panic_on_err("write_fixed", false);
+        if (co_await service.read_fixed(fd, large, 100, 0) != 100 || large.data()[99] != 'a') throw std::runtime_error("Bad read_fixed");
+
+        // Grows by registering more regions into the sparse table, until it's full
+        std::vector<uio::fixed_buffer> blocks;
+        while (auto block = pool.acquire(64 * 1024)) blocks.push_back(std::move(block));
+        fmt::print("{} blocks in {}KiB\n", pool.size(), pool.capacity() / 1024);
+        if (pool.capacity() != 3 * 256 * 1024 || blocks.back().buf_index() != 2) throw std::runtime_error("Didn't grow");
+
+        // Blocks of the last region work too
+        memcpy(blocks.back().data(), "region", 6);
+        co_await service.write_fixed(fd, blocks.back(), 6, 0) | panic_on_err("write_fixed", false);
+        if (co_await service.read_fixed(fd, small, 6, 0) != 6 || memcmp(small.data(), "region", 6)) throw std::runtime_error("Bad region");
+
+        // Blocks given back are handed out again
+        auto* data = blocks.front().data();
+        blocks.erase(blocks.begin());
+        if (pool.acquire(60000).data() != data) throw std::runtime_error("Not reused");
+        close(fd);
+    }());
+
+    // Regions smaller than a slab are carved whole
+    io_service other;
+    uio::fixed_buffer_pool tiny(other, 16 * 1024, 2);
+    {
+        std::vector<uio::fixed_buffer> blocks;
+        while (auto block = tiny.acquire(4096)) {
+            memset(block.data(), 'b', block.size());
+            blocks.push_back(std::move(block));
+        }
+        fmt::print("{} blocks in {}KiB\n", tiny.size(), tiny.capacity() / 1024);
+        if (blocks.size() != 8 || tiny.capacity() != 32 * 1024) throw std::runtime_error("Bad small regions");
+    }
+}
@@ -0,0 +1,75 @@
+#include <fmt/core.h>
+
+#include <liburing/io_service.hpp>
+#include <stdexcept>
+#include <thread>
+
+// A bump allocator that never frees
+struct arena_allocator final: uio::frame_allocator {
+    void* allocate(size_t size) override {
+        size = (size + 15) & ~size_t(15);
+        if (used + size > sizeof (storage)) throw std::bad_alloc();
+        ++allocated;
+        return storage + std::exchange(used, used + size);
+    }
+    void deallocate(void*, size_t) noexcept override {
+        ++freed;
+    }
+
+    alignas(16) char storage[64 << 10];
+    size_t used = 0;
+    int allocated = 0;
+    int freed = 0;
+};
+
+void check(bool cond, const char* what) {
+    if (!cond) throw std::runtime_error(what);
+}
+
+int main() {
+    using uio::io_service;
+    using uio::task;
+
+    io_service service;
+
+    auto child = [&] (int i) -> task<int> {
+        co_await service.yield();
+        co_return i * 2;
+    };
+
+    const auto before = uio::get_frame_stats();
+    service.run([&] () -> task<> {
+        for (int i = 0; i < 100; ++i) {
+            check(co_await child(i) == i * 2, "child");
+        }
+
+        auto stats = uio::get_frame_stats();
+        fmt::print("allocations: {}, pool hits: {}, live frames: {}, live bytes: {}\n",
+            stats.allocations, stats.pool_hits, stats.live_frames, stats.live_bytes);
+        // Only the frame of this coroutine is alive, children are recycled
+        check(stats.live_frames - before.live_frames == 1, "live frames");
+        check(stats.pool_hits - before.pool_hits >= 99, "pool hits");
+
+        arena_allocator arena;
+        auto* prev = uio::set_frame_allocator(&arena);
+        auto t = child(21);
+        uio::set_frame_allocator(prev);
+        check(arena.allocated == 1, "arena allocate");
+        check(co_await t == 42, "arena child");
+        t = task<int>();
+        check(arena.freed == 1, "arena deallocate");
+    }());
+
+    check(uio::get_frame_stats().live_frames == before.live_frames, "leaked frames");
+
+    // Freed by a thread_local destructor after the pool of the thread is gone
+    std::thread([] {
+        struct late_free {
+            uio::callback_resolver* resolver = nullptr;
+            ~late_free() { if (resolver) resolver->resolve(0); }
+        };
+        // Constructed before the pool, so destructed after it
+        thread_local late_free late;
+        late.resolver = uio::callback_resolver::create([](int) {});
+    }).join();
+}
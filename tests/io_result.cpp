@@ -0,0 +1,57 @@
+#include <fmt/core.h>
+
+#include <liburing/io_service.hpp>
+#include <chrono>
+#include <stdexcept>
+#include <system_error>
+
+int main() {
+    using uio::io_service;
+    using uio::task;
+    using uio::panic_on_err;
+    using uio::as_result;
+    using namespace std::literals;
+
+    io_service service;
+
+    int fds[2];
+    pipe(fds) | panic_on_err("pipe", true);
+
+    service.run([] (io_service& service, int* fds) -> task<> {
+        // A value, checked in await_resume of the wrapped op, or after it's awaited
+        uio::io_result r = co_await (service.write(fds[1], "abc", 3, 0) | as_result);
+        if (!r || !r.ok() || r.value() != 3 || r.error()) throw std::runtime_error("Bad success");
+        char buf[3];
+        r = (co_await service.read(fds[0], buf, 3, 0)) | as_result;
+        if (!r.ok() || r.value() != 3) throw std::runtime_error("Bad read");
+
+        // An error is reported as an error_code
+        r = co_await (service.read(-1, buf, 3, 0) | as_result);
+        if (r || r.error() != std::errc::bad_file_descriptor || r.error().category() != std::generic_category()) {
+            throw std::runtime_error("Bad error");
+        }
+
+        // So is the expiration of a timeout
+        auto ts = uio::dur2ts(1ms);
+        r = co_await (service.timeout(&ts) | as_result);
+        if (r || r.error() != std::errc::stream_timeout) throw std::runtime_error("Bad timeout");
+
+        // panic_on_err passes values through, ignores an expiration and throws errors
+        if (co_await (service.write(fds[1], "x", 1, 0) | panic_on_err("write", false)) != 1) {
+            throw std::runtime_error("Bad checked value");
+        }
+        if (co_await (service.timeout(&ts) | panic_on_err("timeout", false)) != -ETIME) {
+            throw std::runtime_error("Expiration rejected");
+        }
+        try {
+            co_await (service.close(-1) | panic_on_err("close", false));
+            throw std::logic_error("Error not thrown");
+        } catch (const std::system_error& e) {
+            if (e.code() != std::errc::bad_file_descriptor) throw;
+        }
+        fmt::print("io_result and panic_on_err checked\n");
+    }(service, fds));
+
+    close(fds[0]);
+    close(fds[1]);
+}
@@ -0,0 +1,53 @@
+#include <sys/socket.h>
+#include <fmt/core.h>
+
+#include <liburing/io_service.hpp>
+#include <chrono>
+#include <stdexcept>
+
+int main() {
+    using uio::io_service;
+    using uio::task;
+    using uio::panic_on_err;
+    using namespace std::literals;
+
+    io_service service;
+
+    int sv[2];
+    socketpair(AF_UNIX, SOCK_STREAM, 0, sv) | panic_on_err("socketpair", true);
+
+    service.run([&] () -> task<> {
+        char c;
+
+        // Nothing to receive
+        auto start = std::chrono::steady_clock::now();
+        int res = co_await service.recv(sv[0], &c, 1, 0).with_timeout(20ms);
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        fmt::print("Timed out recv: {} after {}ms\n", res, elapsed / 1ms);
+        if (res != -ETIME || elapsed < 20ms) throw std::runtime_error("Not timed out");
+
+        // Finishes in time
+        service.send(sv[1], "x", 1, 0);
+        res = co_await service.recv(sv[0], &c, 1, 0).with_timeout(1s);
+        if (res != 1 || c != 'x') throw std::runtime_error("Unexpected result");
+
+        // Both cqes are absorbed: nothing is left to resolve a dead awaiter
+        for (int i = 0; i < 100; ++i) {
+            service.send(sv[1], "x", 1, 0);
+            co_await service.recv(sv[0], &c, 1, 0).with_timeout(1s) | panic_on_err("recv", false);
+        }
+        co_await service.yield();
+    }());
+
+    // The SQ is full once the operation is taken: the link must not be split
+    io_service small(4);
+    small.run([&] () -> task<> {
+        char c;
+        for (int i = 0; i < 3; ++i) (void) small.yield();
+        int res = co_await small.recv(sv[0], &c, 1, 0).with_timeout(20ms);
+        if (res != -ETIME) throw std::runtime_error("Not timed out with a full SQ");
+    }());
+
+    close(sv[0]);
+    close(sv[1]);
+}
@@ -0,0 +1,58 @@
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <fmt/core.h>
+
+#include <liburing/io_service.hpp>
+#include <vector>
+
+int main() {
+    using uio::io_service;
+    using uio::task;
+    using uio::panic;
+    using uio::panic_on_err;
+
+    io_service service;
+
+    int sockfd = socket(AF_INET, SOCK_STREAM, 0) | panic_on_err("socket creation", true);
+    uio::on_scope_exit closesock([=]() { close(sockfd); });
+
+    sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = 0,
+        .sin_addr = { htonl(INADDR_LOOPBACK) },
+        .sin_zero = {},
+    };
+    socklen_t addrlen = sizeof (addr);
+    if (bind(sockfd, reinterpret_cast<sockaddr *>(&addr), addrlen)) panic("socket binding", errno);
+    if (getsockname(sockfd, reinterpret_cast<sockaddr *>(&addr), &addrlen)) panic("getsockname", errno);
+    if (listen(sockfd, 16)) panic("listen", errno);
+
+    service.run([&] () -> task<> {
+        auto connections = service.multishot_accept(sockfd);
+
+        // Connect in batches so that both queued and awaited results are covered
+        std::vector<int> clients;
+        for (int batch = 0; batch < 3; ++batch) {
+            for (int i = 0; i < 4; ++i) {
+                int clientfd = socket(AF_INET, SOCK_STREAM, 0) | panic_on_err("socket creation", true);
+                if (connect(clientfd, reinterpret_cast<sockaddr *>(&addr), addrlen)) panic("connect", errno);
+                clients.push_back(clientfd);
+            }
+            co_await service.yield();
+
+            for (int i = 0; i < 4; ++i) {
+                int fd = co_await connections.next();
+                if (fd < 0) panic("multishot_accept", -fd);
+                fmt::print("batch {}: accepted sockfd {}\n", batch, fd);
+                co_await service.close(fd) | panic_on_err("close", false);
+            }
+        }
+
+        for (int fd : clients) close(fd);
+    }());
+
+    // The stream is destructed while still armed; make sure the kernel cancels it
+    service.run([&] () -> task<> {
+        co_await service.yield();
+    }());
+}
@@ -0,0 +1,82 @@
+#include <sys/socket.h>
+#include <fmt/core.h>
+
+#include <liburing/io_service.hpp>
+#include <chrono>
+#include <string>
+#include <vector>
+
+int main() {
+    using uio::io_service;
+    using uio::buffer_ring;
+    using uio::buffer_lease;
+    using uio::task;
+    using uio::panic_on_err;
+
+    io_service service;
+    // Way fewer buffers than messages, so the kernel runs out of them
+    buffer_ring buffers(service, 2, 2, 8);
+
+    std::array<int, 2> sv;
+    socketpair(AF_UNIX, SOCK_STREAM, 0, sv.data()) | panic_on_err("socketpair", true);
+
+    std::string sent;
+    for (int i = 0; i < 100; ++i) sent += fmt::format("{},", i);
+
+    service.run([&] () -> task<> {
+        auto messages = service.multishot_recv(sv[0], buffers);
+
+        co_await service.send(sv[1], sent.data(), sent.size(), 0) | panic_on_err("send", false);
+        co_await service.close(sv[1]) | panic_on_err("close", false);
+
+        std::string recieved;
+        std::vector<buffer_lease> held;
+        while (true) {
+            auto buf = co_await messages.next();
+            if (buf.result() < 0) uio::panic("multishot_recv", -buf.result());
+            if (buf.result() == 0) break;
+            recieved.append(buf.data(), buf.size());
+
+            // Hold every buffer for a while to exhaust the ring
+            held.push_back(std::move(buf));
+            if (held.size() == 2) {
+                co_await service.yield();
+                held.clear();
+            }
+        }
+
+        fmt::print("Recieved {} bytes\n", recieved.size());
+        if (recieved != sent) throw std::runtime_error("Unexpected message");
+        co_await service.close(sv[0]) | panic_on_err("close", false);
+    }());
+
+    // A slow consumer: while the buffers sit in unconsumed completions, the
+    // request stays parked instead of rearming into -ENOBUFS over and over
+    socketpair(AF_UNIX, SOCK_STREAM, 0, sv.data()) | panic_on_err("socketpair", true);
+    service.run([&] () -> task<> {
+        auto messages = service.multishot_recv(sv[0], buffers);
+
+        for (int i = 0; i < 8; ++i) {
+            co_await service.send(sv[1], "12345678", 8, 0) | panic_on_err("send", false);
+            co_await service.yield();
+        }
+
+        const auto syscalls = service.syscall_count();
+        co_await service.sleep_for(std::chrono::milliseconds(100));
+        const auto idle = service.syscall_count() - syscalls;
+        fmt::print("io_uring_enter while idle: {}\n", idle);
+        if (idle > 10) throw std::runtime_error("Rearming while buffers are held");
+
+        std::string recieved;
+        while (recieved.size() < 64) {
+            auto buf = co_await messages.next();
+            if (buf.result() <= 0) uio::panic("multishot_recv", -buf.result());
+            recieved.append(buf.data(), buf.size());
+        }
+        std::string expected;
+        for (int i = 0; i < 8; ++i) expected += "12345678";
+        if (recieved != expected) throw std::runtime_error("Unexpected message");
+        co_await service.close(sv[1]) | panic_on_err("close", false);
+        co_await service.close(sv[0]) | panic_on_err("close", false);
+    }());
+}
@@ -0,0 +1,76 @@
+#include <fmt/core.h>
+
+#include <liburing/io_service.hpp>
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+enum { PRODUCERS = 4, POSTS = 10000 };
+
+struct state {
+    int last[PRODUCERS];
+    int received = 0;
+    std::thread::id spawned_on;
+};
+
+int main() {
+    using uio::io_service;
+    using uio::task;
+
+    {
+        io_service service;
+        state st;
+        std::fill(std::begin(st.last), std::end(st.last), -1);
+        uio::async_event done(service);
+
+        std::vector<std::thread> producers;
+        for (int p = 0; p < PRODUCERS; ++p) {
+            producers.emplace_back([&, p] {
+                for (int i = 0; i < POSTS; ++i) {
+                    service.post([&, p, i] {
+                        // Functions of one producer run in the order they were posted
+                        if (st.last[p] + 1 != i) std::terminate();
+                        st.last[p] = i;
+                        if (++st.received == PRODUCERS * POSTS + 1) done.set();
+                    });
+                }
+            });
+        }
+        // The task is created on the thread running the service
+        std::thread spawner([&] {
+            service.spawn([&st, &done] (io_service& service) {
+                return [] (io_service& service, state& st, uio::async_event& done) -> task<> {
+                    st.spawned_on = std::this_thread::get_id();
+                    co_await service.yield();
+                    if (++st.received == PRODUCERS * POSTS + 1) done.set();
+                }(service, st, done);
+            });
+        });
+
+        service.run([] (uio::async_event& done) -> task<> {
+            co_await done.wait();
+        }(done));
+        for (auto& thread : producers) thread.join();
+        spawner.join();
+
+        fmt::print("Ran {} posted functions, io_uring_enter {}\n", st.received, service.syscall_count());
+        if (st.spawned_on != std::this_thread::get_id()) throw std::runtime_error("Spawned on another thread");
+    }
+
+    {
+        // Functions still queued when the service goes away are freed, not run
+        auto token = std::make_shared<int>(0);
+        bool ran = false;
+        {
+            io_service service;
+            std::thread([&] {
+                for (int i = 0; i < 100; ++i) service.post([token, &ran] { ran = true; });
+            }).join();
+            if (token.use_count() != 101) throw std::runtime_error("Functions not queued");
+        }
+        if (ran || token.use_count() != 1) throw std::runtime_error("Queued functions leaked or ran");
+    }
+}
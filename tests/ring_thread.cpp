@@ -0,0 +1,44 @@
+#include <sys/wait.h>
+#include <signal.h>
+#include <fmt/core.h>
+
+#include <liburing/io_service.hpp>
+#include <stdexcept>
+#include <thread>
+
+int main() {
+    using uio::io_service;
+    using uio::task;
+    using uio::panic_on_err;
+
+    auto work = [] (io_service& service) -> task<int> {
+        co_return co_await service.yield();
+    };
+
+    {
+        io_service service;
+        // The ring fd falls back to being looked up on kernels older than 5.18
+        if (service.get_handle().enter_ring_fd == service.get_handle().ring_fd) {
+            fmt::print("Ring fd not registered, skipped\n");
+            return 0;
+        }
+
+        // Run on another thread with the registered ring fd of this one: enter fails, which terminates
+        pid_t pid = fork() | panic_on_err("fork", true);
+        if (pid == 0) {
+            std::thread([&] { service.run(work(service)); }).join();
+            _exit(0);
+        }
+        int status;
+        waitpid(pid, &status, 0) | panic_on_err("waitpid", true);
+        if (!WIFSIGNALED(status) || WTERMSIG(status) != SIGABRT) throw std::runtime_error("Ran off its thread unnoticed");
+    }
+
+    // Fine once unregistered
+    io_service service;
+    service.unregister_ring_fd() | panic_on_err("unregister_ring_fd", false);
+    int res = -1;
+    std::thread([&] { res = service.run(work(service)); }).join();
+    if (res != 0) throw std::runtime_error(fmt::format("yield: {}", res));
+    fmt::print("Ran on another thread once unregistered\n");
+}
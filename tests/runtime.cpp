@@ -0,0 +1,58 @@
+#include <fmt/core.h>
+
+#include <liburing/runtime.hpp>
+#include <atomic>
+#include <stdexcept>
+
+std::atomic<int> spawned = 0;
+std::atomic<int> hops = 0;
+
+// Pass a token to the next core until it has made 100 hops
+void relay(uio::runtime& rt) {
+    if (++hops == 100) return rt.stop();
+    rt.post((rt.current_core() + 1) % rt.size(), [&rt] { relay(rt); });
+}
+
+int main() {
+    using uio::runtime;
+    using uio::io_service;
+    using uio::task;
+
+    runtime rt(4);
+
+    for (unsigned core = 0; core < rt.size(); ++core) {
+        rt.spawn_on(core, [&, core] (io_service& service) -> task<> {
+            if (rt.current_core() != int(core)) throw std::runtime_error("Wrong core");
+            co_await service.yield();
+            // The last one starts the relay from a worker thread
+            if (++spawned == int(rt.size())) relay(rt);
+        });
+    }
+
+    rt.run_until_stopped();
+    fmt::print("Spawned {} coroutines, relayed {} times across {} threads\n", spawned.load(), hops.load(), rt.size());
+    if (spawned != int(rt.size()) || hops != 100) throw std::runtime_error("Unexpected counters");
+
+    // Stopped: posts are dropped rather than sent to rings that are gone
+    bool ran = false;
+    rt.post(0, [&ran] { ran = true; });
+    if (ran) throw std::runtime_error("Posted after stop");
+
+    {
+        // Stealable coroutines hop through the run queues, awaiting a task in between
+        runtime rt(2);
+        std::atomic<int> done = 0;
+        for (int i = 0; i < 8; ++i) {
+            rt.spawn_on(0, [&] (io_service&) -> uio::stealable {
+                for (int hop = 0; hop < 4; ++hop) {
+                    auto& current = co_await rt.schedule();
+                    if (&current != &rt.service(rt.current_core())) throw std::runtime_error("Wrong service");
+                    co_await [] (io_service& service) -> task<> { co_await service.yield(); }(current);
+                }
+                if (++done == 8) rt.stop();
+            });
+        }
+        rt.run_until_stopped();
+        if (done != 8) throw std::runtime_error("Lost stealable coroutines");
+    }
+}
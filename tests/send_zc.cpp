@@ -0,0 +1,84 @@
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <fmt/core.h>
+
+#include <liburing/io_service.hpp>
+#include <memory>
+#include <string>
+#include <vector>
+
+int main() {
+    using uio::io_service;
+    using uio::task;
+    using uio::panic;
+    using uio::panic_on_err;
+
+    io_service service;
+
+    // Zero-copy send is not supported on AF_UNIX sockets
+    int listener = socket(AF_INET, SOCK_STREAM, 0) | panic_on_err("socket creation", true);
+    sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = 0,
+        .sin_addr = { htonl(INADDR_LOOPBACK) },
+        .sin_zero = {},
+    };
+    socklen_t addrlen = sizeof (addr);
+    if (bind(listener, reinterpret_cast<sockaddr *>(&addr), addrlen)) panic("socket binding", errno);
+    if (getsockname(listener, reinterpret_cast<sockaddr *>(&addr), &addrlen)) panic("getsockname", errno);
+    if (listen(listener, 1)) panic("listen", errno);
+
+    int sender = socket(AF_INET, SOCK_STREAM, 0) | panic_on_err("socket creation", true);
+    if (connect(sender, reinterpret_cast<sockaddr *>(&addr), addrlen)) panic("connect", errno);
+    int receiver = accept(listener, nullptr, nullptr) | panic_on_err("accept", true);
+    close(listener);
+
+    service.run([&] () -> task<> {
+        std::string message(64 << 10, 'x');
+
+        // Await both cqes
+        auto op = service.send_zc(sender, message.data(), message.size(), MSG_NOSIGNAL);
+        int sent = co_await op | panic_on_err("send_zc", false);
+        co_await op.notified();
+        if (!op.is_notified()) throw std::runtime_error("Not notified");
+        fmt::print("Sent {} bytes\n", sent);
+
+        // Fire and forget, the request outlives the zc_send object
+        service.send_zc(sender, message.data(), message.size(), MSG_NOSIGNAL);
+
+        std::vector<char> buf(message.size());
+        size_t total = 0;
+        while (total < size_t(sent) + message.size()) {
+            int r = co_await service.recv(receiver, buf.data(), buf.size(), 0) | panic_on_err("recv", false);
+            if (r == 0) throw std::runtime_error("Unexpected EOF");
+            total += size_t(r);
+        }
+        fmt::print("Recieved {} bytes\n", total);
+
+        // A failed send posts no notification
+        auto failed = service.send_zc(-1, message.data(), message.size(), MSG_NOSIGNAL);
+        if (auto r = co_await failed | uio::as_result; r.error() != std::errc::bad_file_descriptor) {
+            throw std::runtime_error("Unexpected result of send_zc");
+        }
+        co_await failed.notified();
+
+        // A waiter of each kind, resumed by the result alone. The first one drops the zc_send object
+        auto shared = std::make_unique<uio::zc_send>(service.send_zc(-1, message.data(), message.size(), MSG_NOSIGNAL));
+        int result = 0;
+        bool notified = false;
+        auto result_waiter = [] (std::unique_ptr<uio::zc_send>& op, int& result) -> task<> {
+            result = co_await *op;
+            op.reset();
+        }(shared, result);
+        auto notif_waiter = [] (uio::zc_send& op, bool& notified) -> task<> {
+            co_await op.notified();
+            notified = true;
+        }(*shared, notified);
+        co_await result_waiter;
+        co_await notif_waiter;
+        if (result != -EBADF || !notified || shared) throw std::runtime_error("Waiters not resumed");
+    }());
+
+    close(sender);
+    close(receiver);
+}
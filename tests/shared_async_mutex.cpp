@@ -0,0 +1,80 @@
+#include <fmt/core.h>
+
+#include <liburing/io_service.hpp>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+int main() {
+    using uio::io_service;
+    using uio::task;
+
+    {
+        // Rings on different threads contend for one counter, holding the lock across suspension points
+        enum { THREADS = 4, COROUTINES = 8, INCREMENTS = 5000 };
+        struct shared {
+            uio::shared_async_mutex mutex;
+            long counter = 0;
+            int inside = 0;
+        } state;
+
+        std::vector<std::thread> threads;
+        for (int t = 0; t < THREADS; ++t) {
+            threads.emplace_back([&state] {
+                io_service service;
+                service.run([] (io_service& service, shared& state) -> task<> {
+                    std::vector<task<>> tasks;
+                    for (int c = 0; c < COROUTINES; ++c) {
+                        tasks.push_back([] (io_service& service, shared& state) -> task<> {
+                            for (int i = 0; i < INCREMENTS; ++i) {
+                                co_await state.mutex.lock(service);
+                                if (++state.inside != 1) throw std::runtime_error("Not exclusive");
+                                const long value = state.counter;
+                                if (i % 16 == 0) co_await service.yield();
+                                state.counter = value + 1;
+                                --state.inside;
+                                state.mutex.unlock(service);
+                            }
+                        }(service, state));
+                    }
+                    co_await uio::when_all(tasks);
+                }(service, state));
+            });
+        }
+        for (auto& thread : threads) thread.join();
+
+        fmt::print("counter {} of {}\n", state.counter, THREADS * COROUTINES * INCREMENTS);
+        if (state.counter != THREADS * COROUTINES * INCREMENTS) throw std::runtime_error("Lost increments");
+    }
+
+    io_service service;
+    service.run([&] () -> task<> {
+        // The word doesn't hold the expected value: no wait at all
+        uint32_t word = 1;
+        if (int res = co_await service.futex_wait(&word, 0); res != -EAGAIN) {
+            throw std::runtime_error(fmt::format("futex_wait: {}", res));
+        }
+
+        // Woken up through the second of two futexes
+        uint32_t words[2] = {};
+        futex_waitv futexes[2];
+        for (int i = 0; i < 2; ++i) {
+            futexes[i] = {
+                .val = 0,
+                .uaddr = uint64_t(reinterpret_cast<uintptr_t>(&words[i])),
+                .flags = FUTEX2_SIZE_U32 | FUTEX2_PRIVATE,
+                .__reserved = 0,
+            };
+        }
+        auto waiter = [] (io_service& service, futex_waitv* futexes) -> task<int> {
+            co_return co_await service.futex_waitv(futexes, 2);
+        }(service, futexes);
+        // Let the wait reach the kernel first
+        co_await service.yield();
+        if (int woken = co_await service.futex_wake(&words[1], 1); woken != 1) {
+            throw std::runtime_error(fmt::format("futex_wake: {}", woken));
+        }
+        if (int index = co_await waiter; index != 1) throw std::runtime_error(fmt::format("futex_waitv: {}", index));
+        fmt::print("futex_waitv woken up through futex {}\n", 1);
+    }());
+}
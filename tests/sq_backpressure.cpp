@@ -0,0 +1,70 @@
+#include <fmt/core.h>
+
+#include <liburing/io_service.hpp>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+
+int main() {
+    using uio::io_service;
+    using uio::task;
+    using namespace std::literals;
+
+    enum { OPS = 50000, TIMEOUTS = 40 };
+
+    // Far more operations in flight than the SQ and the CQ hold
+    io_service service(8, uio::setup_options { .cq_entries = 16 });
+    if (service.get_handle().cq.ring_entries != 16) throw std::runtime_error("CQSIZE is not applied");
+
+    int done = 0;
+    service.run([] (io_service& service, int& done) -> task<> {
+        for (int i = 0; i < OPS; ++i) {
+            co_await service.reserve_sqes(2);
+            auto& ring = service.get_handle();
+            if (io_uring_sq_space_left(&ring) < 2 || *ring.sq.kflags & IORING_SQ_CQ_OVERFLOW) {
+                throw std::runtime_error("Resumed without room");
+            }
+            service.yield().set_callback([&done](int res) {
+                if (res != 0) uio::panic("yield", -res);
+                ++done;
+            });
+            // Nobody awaits it; its cqe is skipped
+            service.yield(IOSQE_CQE_SKIP_SUCCESS);
+        }
+        while (done < OPS) co_await service.yield();
+    }(service, done));
+
+    fmt::print("{} operations done with {} syscalls\n", done, service.syscall_count());
+
+    // More completions than the CQ holds land between two reaps: a waiter is resumed only once
+    // the kernel flushed the overflowed ones
+    struct overflow_state {
+        int expired = 0;
+        bool overflowed = false;
+    } st;
+    service.run([] (io_service& service, overflow_state& st) -> task<> {
+        auto& ring = service.get_handle();
+        auto ts = uio::dur2ts(10ms);
+        for (int i = 0; i < TIMEOUTS; ++i) {
+            co_await service.reserve_sqes(1);
+            service.timeout(&ts).set_callback([&st, &ring](int res) {
+                if (res != -ETIME) uio::panic("timeout", -res);
+                if (*ring.sq.kflags & IORING_SQ_CQ_OVERFLOW) st.overflowed = true;
+                ++st.expired;
+            });
+        }
+        co_await service.yield();
+        // Block the run loop while all of them expire
+        std::this_thread::sleep_for(50ms);
+
+        // Not enough room: parked until the run loop submits
+        service.yield().set_callback([](int) {});
+        co_await service.reserve_sqes(ring.sq.ring_entries);
+        if (*ring.sq.kflags & IORING_SQ_CQ_OVERFLOW || st.expired != TIMEOUTS) {
+            throw std::runtime_error(fmt::format("Resumed with {} of {} timeouts reaped", st.expired, int(TIMEOUTS)));
+        }
+    }(service, st));
+
+    fmt::print("{} timeouts through a {} entries CQ, overflowed: {}\n", st.expired, service.get_handle().cq.ring_entries, st.overflowed);
+    if (!st.overflowed) throw std::runtime_error("The CQ didn't overflow");
+}
@@ -0,0 +1,38 @@
+#include <sys/socket.h>
+#include <fmt/core.h>
+
+#include <liburing/io_service.hpp>
+#include <chrono>
+#include <stdexcept>
+
+int main() {
+    using uio::io_service;
+    using uio::task;
+    using uio::panic_on_err;
+    using namespace std::literals;
+
+    // Far more sqes than SQ entries: the SQ thread takes them whenever it runs
+    enum { ENTRIES = 4, OPS = 2000 };
+    io_service service(ENTRIES, uio::sqpoll_options { .idle_ms = 10 });
+    if (!(service.get_handle().flags & IORING_SETUP_SQPOLL)) throw std::runtime_error("No SQPOLL");
+
+    int sv[2];
+    socketpair(AF_UNIX, SOCK_STREAM, 0, sv) | panic_on_err("socketpair", true);
+
+    service.run([&] () -> task<> {
+        int done = 0;
+        for (int i = 0; i < OPS; ++i) service.yield().set_callback([&done](int) { ++done; });
+        while (done < OPS) co_await service.yield();
+
+        // Links taken on a full SQ stay whole
+        char c;
+        for (int i = 0; i < 50; ++i) {
+            for (int j = 0; j < ENTRIES - 1; ++j) (void) service.yield();
+            if (co_await service.recv(sv[0], &c, 1, 0).with_timeout(1ms) != -ETIME) throw std::runtime_error("Not timed out");
+        }
+        fmt::print("{} ops through a {} entries SQ, io_uring_enter {}\n", OPS, ENTRIES, service.syscall_count());
+    }());
+
+    close(sv[0]);
+    close(sv[1]);
+}
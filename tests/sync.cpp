@@ -0,0 +1,86 @@
+#include <fmt/core.h>
+
+#include <liburing/io_service.hpp>
+#include <stdexcept>
+#include <vector>
+
+int main() {
+    using uio::io_service;
+    using uio::task;
+
+    io_service service;
+
+    service.run([] (io_service& service) -> task<> {
+        // Mutual exclusion across suspension points, handed over in FIFO order
+        uio::async_mutex mutex(service);
+        std::vector<int> order;
+        int inside = 0;
+        auto locker = [] (io_service& service, uio::async_mutex& mutex, std::vector<int>& order, int& inside, int id) -> task<> {
+            auto lock = co_await mutex.scoped_lock();
+            if (++inside != 1) throw std::runtime_error("Not exclusive");
+            co_await service.yield();
+            order.push_back(id);
+            --inside;
+        };
+        std::vector<task<>> tasks;
+        for (int i = 0; i < 5; ++i) tasks.push_back(locker(service, mutex, order, inside, i));
+        for (auto& t : tasks) co_await t;
+        if (order != std::vector { 0, 1, 2, 3, 4 } || !mutex.try_lock()) throw std::runtime_error("Bad async_mutex");
+        mutex.unlock();
+
+        // Permits go to waiters first
+        uio::async_semaphore sem(service, 2);
+        co_await sem.acquire();
+        co_await sem.acquire();
+        bool acquired = false;
+        auto waiter = [] (uio::async_semaphore& sem, bool& acquired) -> task<> {
+            co_await sem.acquire();
+            acquired = true;
+        }(sem, acquired);
+        sem.release(2);
+        if (sem.available() != 1 || sem.try_acquire() != true || sem.try_acquire() != false) throw std::runtime_error("Bad async_semaphore");
+        co_await waiter;
+        if (!acquired) throw std::runtime_error("Bad async_semaphore");
+
+        // The notified waiter wakes up owning the mutex
+        uio::async_condition_variable cv(service);
+        int value = 0;
+        auto consumer = [] (uio::async_mutex& mutex, uio::async_condition_variable& cv, int& value) -> task<int> {
+            co_await mutex.lock();
+            co_await cv.wait(mutex, [&] { return value != 0; });
+            int result = value;
+            mutex.unlock();
+            co_return result;
+        }(mutex, cv, value);
+        co_await service.yield();
+        co_await mutex.lock();
+        value = 42;
+        cv.notify_all();
+        mutex.unlock();
+        if (co_await consumer != 42) throw std::runtime_error("Bad async_condition_variable");
+
+        // Everybody waits for the last one
+        uio::async_latch latch(service, 3);
+        int arrived = 0;
+        auto arrive = [] (uio::async_latch& latch, int& arrived) -> task<> {
+            ++arrived;
+            co_await latch.arrive_and_wait();
+            if (arrived != 3) throw std::runtime_error("Bad async_latch");
+        };
+        auto a = arrive(latch, arrived), b = arrive(latch, arrived), c = arrive(latch, arrived);
+        co_await a;
+        co_await b;
+        co_await c;
+
+        uio::async_event event(service);
+        auto set_later = [] (io_service& service, uio::async_event& event) -> task<> {
+            co_await service.yield();
+            event.set();
+        }(service, event);
+        co_await event.wait();
+        co_await event.wait();
+        co_await set_later;
+
+        fmt::print("{} io_uring_enter calls\n", service.syscall_count());
+    }(service));
+}
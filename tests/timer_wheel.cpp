@@ -0,0 +1,109 @@
+#include <fmt/core.h>
+
+#include <liburing/io_service.hpp>
+#include <chrono>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+// Fire nodes of a bare wheel at random ticks, and check they expire in order and on time
+void check_wheel() {
+    struct node: uio::timer_node {
+        uint64_t* last;
+        uint64_t* fired;
+    };
+
+    uio::timer_wheel wheel(12345);
+    std::vector<node> nodes(10000);
+    uint64_t last = 0, fired = 0;
+    std::mt19937_64 rng(42);
+    for (auto& n : nodes) {
+        // Spread over several levels
+        n.expires = wheel.now() + 1 + rng() % (uint64_t(1) << (rng() % 30));
+        n.last = &last;
+        n.fired = &fired;
+        n.expire = [](uio::timer_node* self) noexcept {
+            auto* n = static_cast<node *>(self);
+            if (n->expires < *n->last) std::abort();
+            *n->last = n->expires;
+            ++*n->fired;
+        };
+        wheel.add(n);
+    }
+    // Canceled ones never fire
+    for (size_t i = 0; i < nodes.size(); i += 2) wheel.remove(nodes[i]);
+
+    for (uint64_t now = wheel.now(); !wheel.empty(); now += 1 + rng() % 100000) {
+        wheel.advance(now);
+        if (last > now) throw std::runtime_error("Fired early");
+    }
+    fmt::print("Bare wheel fired {} nodes\n", fired);
+    if (fired != nodes.size() / 2) throw std::runtime_error("Unexpected fired count");
+}
+
+int main() {
+    using uio::io_service;
+    using uio::task;
+    using namespace std::literals;
+
+    check_wheel();
+
+    io_service service;
+    service.run([&] () -> task<> {
+        auto start = std::chrono::steady_clock::now();
+        co_await service.sleep_for(20ms);
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        fmt::print("Slept for {}ms\n", elapsed / 1ms);
+        if (elapsed < 20ms) throw std::runtime_error("Woke up early");
+
+        co_await service.sleep_until(std::chrono::system_clock::now() + 10ms);
+
+        // An earlier REALTIME sleep moves the kernel timeout armed for a later one
+        [](io_service& service) -> task<> {
+            co_await service.sleep_until(std::chrono::system_clock::now() + 1s);
+        }(service);
+        start = std::chrono::steady_clock::now();
+        co_await service.sleep_until(std::chrono::system_clock::now() + 10ms);
+        elapsed = std::chrono::steady_clock::now() - start;
+        fmt::print("Rearmed REALTIME sleep for {}ms\n", elapsed / 1ms);
+        if (elapsed > 500ms) throw std::runtime_error("REALTIME timer not rearmed");
+
+        // The earlier timer fires first, the canceled one never does
+        int fired = 0;
+        uio::timer late(service, [&] { fired = fired * 10 + 2; });
+        uio::timer early(service, [&] { fired = fired * 10 + 1; });
+        uio::timer canceled(service, [&] { fired = fired * 10 + 3; });
+        late.expires_after(30ms);
+        canceled.expires_after(20ms);
+        early.expires_after(10ms);
+        canceled.cancel();
+        co_await service.sleep_for(50ms);
+        fmt::print("Fired timers: {}\n", fired);
+        if (fired != 12 || late.armed()) throw std::runtime_error("Unexpected timers");
+
+        // Sleeps stopped while pending, before being awaited, and never
+        uio::stop_source source;
+        [](io_service& service, uio::stop_source& source) -> task<> {
+            co_await service.sleep_for(10ms);
+            source.request_stop();
+        }(service, source);
+        int res = co_await service.sleep_for(1h).cancel_on(source.get_token());
+        fmt::print("Canceled pending sleep: {}\n", res);
+        if (res != -ECANCELED) throw std::runtime_error("Sleep not canceled");
+        res = co_await service.sleep_for(1h).cancel_on(source.get_token());
+        if (res != -ECANCELED) throw std::runtime_error("Stopped sleep not canceled");
+        uio::stop_source unused;
+        res = co_await service.sleep_for(10ms).cancel_on(unused.get_token());
+        if (res != 0) throw std::runtime_error("Unexpected sleep result");
+
+        // A sleeping coroutine is destroyed, its sleep leaves the wheel
+        fired = 0;
+        auto sleeper = [](io_service& service, int& fired) -> task<> {
+            co_await service.sleep_for(10ms);
+            fired = -1;
+        }(service, fired);
+        sleeper = task<>();
+        co_await service.sleep_for(30ms);
+        if (fired != 0) throw std::runtime_error("Destroyed sleep resumed");
+    }());
+}
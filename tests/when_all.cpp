@@ -0,0 +1,111 @@
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include <fmt/core.h>
+
+#include <liburing/io_service.hpp>
+#include <chrono>
+#include <stdexcept>
+#include <vector>
+
+int main() {
+    using uio::io_service;
+    using uio::task;
+    using uio::panic_on_err;
+    using namespace std::literals;
+
+    io_service service;
+
+    int sv[2];
+    socketpair(AF_UNIX, SOCK_STREAM, 0, sv) | panic_on_err("socketpair", true);
+
+    service.run([] (io_service& service, int* sv) -> task<> {
+        auto delay = [] (io_service& service, int ms) -> task<int> {
+            auto ts = uio::dur2ts(std::chrono::milliseconds(ms));
+            co_await service.timeout(&ts);
+            co_return ms;
+        };
+
+        // Runs concurrently: takes as long as the slowest one
+        auto start = std::chrono::steady_clock::now();
+        auto ts = uio::dur2ts(30ms);
+        auto [slept, a, b] = co_await uio::when_all(service.timeout(&ts), delay(service, 20), delay(service, 30));
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        fmt::print("when_all: {} {} {} after {}ms\n", slept, a, b, elapsed / 1ms);
+        if (slept != -ETIME || a != 20 || b != 30 || elapsed >= 60ms) throw std::runtime_error("Bad when_all");
+
+        // Range form, with children finished before being awaited
+        std::vector<task<int>> tasks;
+        for (int i = 0; i < 10; ++i) tasks.push_back(delay(service, i));
+        auto& last = tasks.back();
+        co_await last;
+        auto results = co_await uio::when_all(tasks);
+        for (int i = 0; i < 10; ++i) {
+            if (results[i] != i) throw std::runtime_error("Bad range result");
+        }
+
+        // The loser is canceled, the winner is reported
+        char c;
+        start = std::chrono::steady_clock::now();
+        auto [index, result] = co_await uio::when_any(service.recv(sv[0], &c, 1, 0), delay(service, 10));
+        elapsed = std::chrono::steady_clock::now() - start;
+        fmt::print("when_any: #{} after {}ms\n", index, elapsed / 1ms);
+        if (index != 1 || std::get<1>(result) != 10 || elapsed >= 1s) throw std::runtime_error("Bad when_any");
+
+        // Nothing is left pending: the canceled recv doesn't take the next byte
+        co_await service.send(sv[1], "x", 1, 0);
+        if (co_await service.recv(sv[0], &c, 1, 0) != 1 || c != 'x') throw std::runtime_error("Recv is not canceled");
+
+        std::vector<uio::sqe_awaitable> ops;
+        char bufs[3];
+        for (char& buf : bufs) ops.push_back(service.recv(sv[0], &buf, 1, 0));
+        service.send(sv[1], "y", 1, 0);
+        auto [first, res] = co_await uio::when_any(ops);
+        fmt::print("when_any range: #{} {}\n", first, res);
+        if (res != 1 || bufs[first] != 'y') throw std::runtime_error("Bad range when_any");
+    }(service, sv));
+
+    // More sqes than the SQ holds: the first ones are submitted before they are joined, which terminates
+    auto oversized = [] (bool range) {
+        pid_t pid = fork() | panic_on_err("fork", true);
+        if (pid == 0) {
+            io_service small(8);
+            small.run([] (io_service& service, bool range) -> task<> {
+                if (range) {
+                    std::vector<uio::sqe_awaitable> ops;
+                    for (int i = 0; i < 9; ++i) ops.push_back(service.yield());
+                    co_await uio::when_all(ops);
+                } else {
+                    co_await uio::when_all(service.yield(), service.yield(), service.yield(), service.yield(),
+                        service.yield(), service.yield(), service.yield(), service.yield(), service.yield());
+                }
+            }(small, range));
+            _exit(0);
+        }
+        int status;
+        waitpid(pid, &status, 0) | panic_on_err("waitpid", true);
+        if (!WIFSIGNALED(status) || WTERMSIG(status) != SIGABRT) throw std::runtime_error("Batch larger than the SQ accepted");
+    };
+    oversized(true);
+    oversized(false);
+
+    // Fits once reserved
+    io_service small(8);
+    small.run([] (io_service& service) -> task<> {
+        std::vector<uio::sqe_awaitable> ops;
+        for (int batch = 0; batch < 20; batch += 5) {
+            ops.clear();
+            co_await service.reserve_sqes(5);
+            for (int i = 0; i < 5; ++i) ops.push_back(service.yield());
+            co_await uio::when_all(ops);
+        }
+        // Awaited with other sqes still queued
+        (void) service.yield();
+        co_await service.reserve_sqes(7);
+        co_await uio::when_all(service.yield(), service.yield(), service.yield(), service.yield(),
+            service.yield(), service.yield(), service.yield());
+    }(small));
+
+    close(sv[0]);
+    close(sv[1]);
+}